@@ -0,0 +1,147 @@
+#include "Algoritmi.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+using namespace std;
+using namespace cv;
+
+typedef map<string, double> Params;
+
+static double param(const Params &params, const string &name, double def) {
+    auto it = params.find(name);
+    return it == params.end() ? def : it->second;
+}
+
+static bool run(const string &algo, const Params &p, Mat &src, Mat &dst) {
+    if (algo == "canny")
+        canny(src, dst, param(p, "LTH", 20), param(p, "HTH", 150));
+    else if (algo == "harris")
+        harris(src, dst, param(p, "k", 0.017), param(p, "TH", 117));
+    else if (algo == "otsu")
+        otsu(src, dst);
+    else if (algo == "otsu2k")
+        otsu2k(src, dst);
+    else if (algo == "kmeans")
+        kmeans(src, dst, param(p, "k", 3));
+    else if (algo == "regionGrowing")
+        regionGrowing(src, dst);
+    else if (algo == "hough_lines")
+        hough_lines(src, dst, param(p, "TH", 150));
+    else if (algo == "hough_circles")
+        hough_circles(src, dst, param(p, "TH", 175), param(p, "Rmin", 20), param(p, "Rmax", 70));
+    else if (algo == "SplitMerge")
+        SplitMergeSegment(src, dst);
+    else
+        return false;
+    return true;
+}
+
+static bool isAlgorithm(const string &algo) {
+    const char *names[] = {"canny", "harris", "otsu", "otsu2k", "kmeans", "regionGrowing", "hough_lines",
+                           "hough_circles", "SplitMerge"};
+    return find(begin(names), end(names), algo) != end(names);
+}
+
+static bool isImage(const string &path) {
+    string ext = path.substr(path.find_last_of('.') + 1);
+    transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "bmp" || ext == "tif" || ext == "tiff";
+}
+
+static void usage() {
+    cerr << "uso: Batch <algoritmo> <immagine|cartella>... -o <cartella> [-j thread] [nome=valore]..." << endl
+         << "algoritmi: canny (LTH, HTH), harris (k, TH), otsu, otsu2k, kmeans (k), regionGrowing," << endl
+         << "           hough_lines (TH), hough_circles (TH, Rmin, Rmax), SplitMerge" << endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    string algo = argv[1], outDir;
+    int jobs = max(1u, thread::hardware_concurrency());
+    Params params;
+    vector<string> files;
+
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+
+        if (arg == "-o" && i + 1 < argc)
+            outDir = argv[++i];
+        else if (arg == "-j" && i + 1 < argc)
+            jobs = max(1, atoi(argv[++i]));
+        else if (eq != string::npos)
+            params[arg.substr(0, eq)] = atof(arg.substr(eq + 1).c_str());
+        else {
+            vector<String> found;
+            try {
+                glob(arg, found, false);
+            } catch (const Exception &e) {
+                cerr << "errore: " << arg << ": " << e.err << endl;
+                usage();
+                return 1;
+            }
+            for (const String &f: found)
+                if (isImage(f))
+                    files.push_back(f);
+        }
+    }
+
+    if (!isAlgorithm(algo) || outDir.empty() || files.empty()) {
+        usage();
+        return 1;
+    }
+
+    vector<string> outPaths;
+    map<string, int> used;
+    for (const string &f: files) {
+        string name = f.substr(f.find_last_of("/\\") + 1);
+        string stem = name.substr(0, name.find_last_of('.')) + "_" + algo;
+        int n = used[stem]++;
+        outPaths.push_back(outDir + "/" + stem + (n ? "_" + to_string(n + 1) : "") + ".png");
+    }
+
+    if (jobs > 1)
+        setNumThreads(1);
+
+    atomic<int> next(0), failed(0);
+    mutex logMutex;
+    TickMeter tm;
+    tm.start();
+
+    vector<thread> workers;
+    for (int w = 0; w < jobs; w++)
+        workers.push_back(thread([&]() {
+            for (int i = next++; i < (int) files.size(); i = next++) {
+                string error;
+                try {
+                    Mat src = imread(files[i], IMREAD_GRAYSCALE), dst;
+                    if (src.empty() || !run(algo, params, src, dst) || !imwrite(outPaths[i], dst))
+                        error = "lettura o scrittura non riuscita";
+                } catch (const exception &e) {
+                    error = e.what();
+                }
+
+                lock_guard<mutex> lock(logMutex);
+                if (error.empty())
+                    cout << files[i] << " -> " << outPaths[i] << endl;
+                else {
+                    cerr << "errore: " << files[i] << ": " << error << endl;
+                    failed++;
+                }
+            }
+        }));
+
+    for (thread &t: workers)
+        t.join();
+    tm.stop();
+
+    cout << files.size() - failed << "/" << files.size() << " immagini in " << tm.getTimeSec() << " s" << endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,250 @@
+#include "Algoritmi.h"
+#include <iostream>
+#include <functional>
+using namespace std;
+using namespace cv;
+
+static double timeMs(const function<void()> &f) {
+    TickMeter tm;
+    tm.start();
+    f();
+    tm.stop();
+    return tm.getTimeMilli();
+}
+
+static void benchCanny() {
+    Mat src = imread("../immagini/fiore.png", IMREAD_GRAYSCALE), dst;
+    int cannyLTH = 20, cannyHTH = 150;
+
+    cout << "canny: " << timeMs([&]() { canny(src, dst, cannyLTH, cannyHTH); }) << " ms" << endl;
+    for (int simd = 0; simd <= 1; simd++) {
+        cannySimd = simd;
+        cout << "canny_fused (" << (simd ? "SIMD" : "scalare") << "): "
+             << timeMs([&]() { canny_fused(src, dst, cannyLTH, cannyHTH); }) << " ms" << endl;
+    }
+
+    const char *images[] = {"fiore", "foglia", "monete", "splash", "strada"};
+    Mat ref, vec;
+    for (const char *name: images) {
+        Mat img = imread(string("../immagini/") + name + ".png", IMREAD_GRAYSCALE);
+        cannySimd = false;
+        canny_fused(img, ref, cannyLTH, cannyHTH);
+        cannySimd = true;
+        canny_fused(img, vec, cannyLTH, cannyHTH);
+        cout << name << ": SIMD " << (norm(ref, vec, NORM_INF) == 0 ? "identico" : "DIVERSO") << " allo scalare" << endl;
+    }
+
+    Mat frame4k, serial, parallel;
+    resize(src, frame4k, Size(3840, 2160));
+    cannyParallel = false;
+    double serialMs = timeMs([&]() { canny_fused(frame4k, serial, cannyLTH, cannyHTH); });
+    cannyParallel = true;
+    for (int threads = 2; threads <= getNumberOfCPUs(); threads *= 2) {
+        setNumThreads(threads);
+        double ms = timeMs([&]() { canny_fused(frame4k, parallel, cannyLTH, cannyHTH); });
+        cout << "canny_fused 4K, isteresi a bande, " << threads << " thread: " << ms << " ms (speedup "
+             << serialMs / ms << "x), " << (norm(serial, parallel, NORM_INF) == 0 ? "identico" : "DIVERSO")
+             << " al seriale" << endl;
+    }
+    setNumThreads(-1);
+}
+
+static void benchHarris() {
+    Mat src = imread("../immagini/foglia.png", IMREAD_GRAYSCALE), dst;
+    float k = 0.017;
+    int threshTH = 117;
+    vector<KeyPoint> corners;
+
+    cout << "harris: " << timeMs([&]() { harris(src, dst, k, threshTH); }) << " ms" << endl;
+    double ms = timeMs([&]() { harris_keypoints(src, corners, k, threshTH); });
+    cout << "harris_keypoints: " << ms << " ms, " << corners.size() << " angoli" << endl;
+
+    Mat frame4k;
+    resize(src, frame4k, Size(3840, 2160));
+    double serialMs = 0;
+    for (int threads = 1; threads <= getNumberOfCPUs(); threads *= 2) {
+        setNumThreads(threads);
+        ms = timeMs([&]() { harris_keypoints(frame4k, corners, k, threshTH); });
+        if (threads == 1)
+            serialMs = ms;
+        cout << "harris_keypoints 4K, " << threads << " thread: " << ms << " ms (speedup " << serialMs / ms << "x)"
+             << endl;
+    }
+    setNumThreads(-1);
+}
+
+static void benchHoughLines() {
+    Mat src = imread("../immagini/strada.png", IMREAD_GRAYSCALE), dst;
+    int houghTH = 150;
+    vector<Vec4i> segments;
+
+    cout << "hough_lines: " << timeMs([&]() { hough_lines(src, dst, houghTH); }) << " ms" << endl;
+    cout << "hough_lines_parallel: " << timeMs([&]() { hough_lines_parallel(src, dst, houghTH, 20); }) << " ms"
+         << endl;
+
+    vector<Vec2f> lines;
+    for (int th: {50, houghTH}) {
+        double exhaustiveMs = timeMs([&]() { hough_lines_detect(src, lines, th, 20); });
+        double ms = timeMs([&]() { hough_lines_probabilistic(src, segments, th, 30, 10); });
+        cout << "soglia " << th << ": hough_lines_detect " << exhaustiveMs << " ms, hough_lines_probabilistic " << ms
+             << " ms, " << segments.size() << " segmenti, recall " << hough_lines_recall(lines, segments) << "/"
+             << lines.size() << endl;
+    }
+
+    EdgeList edges;
+    double ms = timeMs([&]() {
+        canny_fused(src, dst, 20, 150, nullptr, &edges);
+        hough_lines_detect(edges, lines, houghTH, 20);
+    });
+    cout << "canny_fused + hough_lines_detect (lista di " << edges.points.size() << " bordi): " << ms << " ms"
+         << endl;
+}
+
+static void benchHoughCircles() {
+    Mat src = imread("../immagini/monete.png", IMREAD_GRAYSCALE), dst;
+    int houghTH = 175, Rmin = 20, Rmax = 70;
+
+    double ms = timeMs([&]() { hough_circles(src, dst, houghTH, Rmin, Rmax); });
+    size_t nestedBytes = src.rows * (sizeof(vector<vector<int>>) +
+                                     src.cols * (sizeof(vector<int>) + (Rmax - Rmin + 1) * sizeof(int)));
+    cout << "hough_circles: " << ms << " ms, accumulatore " << nestedBytes / 1024 << " KB" << endl;
+
+    for (int compact = 1; compact >= 0; compact--) {
+        size_t accBytes = 0;
+        ms = timeMs([&]() { hough_circles_parallel(src, dst, houghTH, Rmin, Rmax, compact, &accBytes); });
+        cout << "hough_circles_parallel (" << (compact ? "16" : "32") << " bit): " << ms << " ms, accumulatore "
+             << accBytes / 1024 << " KB" << endl;
+    }
+
+    cout << "hough_circles_gradient: " << timeMs([&]() { hough_circles_gradient(src, dst, houghTH, Rmin, Rmax); })
+         << " ms" << endl;
+
+    EdgeList edges;
+    vector<Vec3i> circles;
+    ms = timeMs([&]() {
+        canny_fused(src, dst, 20, 150, nullptr, &edges);
+        hough_circles_detect(edges, circles, houghTH, Rmin, Rmax);
+    });
+    cout << "canny_fused + hough_circles_detect (lista di " << edges.points.size() << " bordi): " << ms << " ms, "
+         << circles.size() << " cerchi" << endl;
+}
+
+static void benchOtsu() {
+    Mat src = imread("../immagini/fiore.png", IMREAD_GRAYSCALE), dst;
+    vector<int> thresholds;
+
+    cout << "otsu: " << timeMs([&]() { otsu(src, dst); }) << " ms" << endl;
+    cout << "otsu2k: " << timeMs([&]() { otsu2k(src, dst); }) << " ms" << endl;
+    for (int K = 2; K <= 4; K++)
+        cout << "otsuMulti K=" << K << ": " << timeMs([&]() { otsuMulti(src, dst, K, thresholds); }) << " ms"
+             << endl;
+}
+
+static void benchKmeans() {
+    Mat src = imread("../immagini/splash.png", IMREAD_GRAYSCALE), dst;
+    int k = 3;
+
+    cout << "kmeans: " << timeMs([&]() { kmeans(src, dst, k); }) << " ms" << endl;
+    cout << "kmeansHist: " << timeMs([&]() { kmeansHist(src, dst, k); }) << " ms" << endl;
+
+    Mat color = imread("../immagini/splash.png", IMREAD_COLOR), frame4k, ref, vec;
+    resize(color, frame4k, Size(3840, 2160));
+    cout << "kmeansColor 4K Lab, k=8: " << timeMs([&]() { kmeansColor(frame4k, dst, 8, true); }) << " ms" << endl;
+    cout << "kmeansColor 4K Lab + x, y, k=8: " << timeMs([&]() { kmeansColor(frame4k, dst, 8, true, 0.5f); })
+         << " ms" << endl;
+    for (int threads = 1; threads <= getNumberOfCPUs(); threads *= 2) {
+        setNumThreads(threads);
+        cout << "kmeansColor 4K mini-batch 4096, " << threads << " thread: "
+             << timeMs([&]() { kmeansColor(frame4k, dst, 8, true, 0, 4096); }) << " ms" << endl;
+    }
+    setNumThreads(-1);
+
+    for (int kc = 8; kc <= 64; kc *= 2) {
+        size_t skipped = 0;
+        double lloydMs = timeMs([&]() { kmeansColor(color, ref, kc, true, 0.5f); });
+        double hamerlyMs = timeMs([&]() { kmeansColor(color, vec, kc, true, 0.5f, 0, true, &skipped); });
+        cout << "kmeansColor Lab + x, y, k=" << kc << ": Lloyd " << lloydMs << " ms, Hamerly " << hamerlyMs
+             << " ms, " << skipped << " distanze saltate, " << (norm(ref, vec, NORM_INF) == 0 ? "identico" : "DIVERSO")
+             << endl;
+    }
+
+    kmeansSimd = false;
+    kmeansColor(color, ref, 8, true);
+    kmeansSimd = true;
+    kmeansColor(color, vec, 8, true);
+    cout << "kmeansColor: SIMD " << (norm(ref, vec, NORM_INF) == 0 ? "identico" : "DIVERSO") << " allo scalare"
+         << endl;
+}
+
+static void benchRegionGrowing() {
+    Mat src = imread("../immagini/splash.png", IMREAD_GRAYSCALE);
+
+    Mat synthetic(2160, 3840, CV_8U);
+    for (int x = 0; x < synthetic.rows; x++)
+        for (int y = 0; y < synthetic.cols; y++)
+            synthetic.at<uchar>(x, y) = (x / 360 * 37 + y / 480 * 91) % 250 + (x + y) % 3;
+
+    Mat labels8, labels, labelsParallel;
+    vector<Rect> boxes;
+    Mat *images[] = {&src, &synthetic};
+    const char *names[] = {"splash.png", "sintetica 4K"};
+
+    for (int i = 0; i < 2; i++) {
+        double naiveMs = timeMs([&]() { regionGrowing(*images[i], labels8); });
+        double scanMs = timeMs([&]() { regionGrowingScan(*images[i], labels, &boxes); });
+        cout << names[i] << ": regionGrowing " << naiveMs << " ms, regionGrowingScan " << scanMs << " ms, "
+             << boxes.size() << " regioni" << endl;
+
+        for (int threads = 1; threads <= getNumberOfCPUs(); threads *= 2) {
+            setNumThreads(threads);
+            double ms = timeMs([&]() { regionGrowingParallel(*images[i], labelsParallel, &boxes); });
+            cout << "  regionGrowingParallel, " << threads << " thread: " << ms << " ms, "
+                 << (norm(labels, labelsParallel, NORM_INF) == 0 ? "identico" : "DIVERSO") << " al seriale" << endl;
+        }
+        setNumThreads(-1);
+    }
+}
+
+static void benchSplitMerge() {
+    Mat src = imread("../immagini/foglia.png", IMREAD_GRAYSCALE);
+    QuadTree tree;
+    Mat imgQuad, imgSeg, imgRAG;
+
+    double ms = timeMs([&]() { SplitMerge(src, tree, imgQuad, imgSeg, imgRAG); });
+    cout << "SplitMerge: " << ms << " ms, " << tree.nodes.size() << " nodi, " << tree.bytes() << " byte" << endl;
+
+    ms = timeMs([&]() { SplitMerge(src, tree, imgQuad, imgSeg, imgRAG); });
+    cout << "SplitMerge (albero e buffer riusati): " << ms << " ms" << endl;
+}
+
+static void benchFrameContext() {
+    Mat src = imread("../immagini/monete.png", IMREAD_GRAYSCALE), edges, corners, circles;
+    FrameContext ctx;
+
+    double separateMs = timeMs([&]() {
+        canny(src, edges, 20, 150);
+        harris(src, corners, 0.017f, 117);
+        hough_circles_gradient(src, circles, 175, 20, 70);
+    });
+    double sharedMs = timeMs([&]() {
+        ctx.reset(src);
+        canny(ctx, edges, 20, 150);
+        harris(ctx, corners, 0.017f, 117);
+        hough_circles_gradient(ctx, circles, 175, 20, 70);
+    });
+    cout << "canny + harris + hough_circles_gradient: " << separateMs << " ms, con FrameContext condiviso "
+         << sharedMs << " ms" << endl;
+}
+
+int main() {
+    benchCanny();
+    benchHarris();
+    benchHoughLines();
+    benchHoughCircles();
+    benchOtsu();
+    benchKmeans();
+    benchRegionGrowing();
+    benchSplitMerge();
+    benchFrameContext();
+    return 0;
+}
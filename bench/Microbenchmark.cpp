@@ -0,0 +1,240 @@
+#include "Algoritmi.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <new>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+using namespace std;
+using namespace cv;
+
+static atomic<size_t> allocations(0);
+
+void *operator new(size_t size) {
+    allocations++;
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+static void resetPeakRSS() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    ofstream("/proc/self/clear_refs") << "5";
+}
+
+static double peakRSSMB() {
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line))
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return atof(line.c_str() + 6) / 1024;
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+struct Algorithm {
+    const char *name;
+    int maxSide;
+    function<void(Mat &, Mat &)> run;
+};
+
+struct Frame {
+    string name;
+    Mat img;
+};
+
+static Mat synthetic(int rows, int cols) {
+    Mat img(rows, cols, CV_8U);
+    for (int x = 0; x < rows; x++)
+        for (int y = 0; y < cols; y++)
+            img.at<uchar>(x, y) = 64 + 64 * x / rows + 32 * y / cols;
+
+    RNG rng(rows * 31 + cols);
+    for (int i = 0; i < 4 * cols / 256; i++) {
+        Point c(rng.uniform(0, cols), rng.uniform(0, rows));
+        Scalar color(rng.uniform(0, 256));
+        if (i % 2)
+            circle(img, c, rng.uniform(20, 70), color, FILLED);
+        else
+            rectangle(img, Rect(c.x, c.y, rng.uniform(16, cols / 4), rng.uniform(16, rows / 4)), color, FILLED);
+    }
+    return img;
+}
+
+static void runAlgorithm(benchmark::State &state, const Algorithm &algo, Mat src) {
+    Mat dst;
+    algo.run(src, dst);
+
+    resetPeakRSS();
+    size_t before = allocations;
+    for (auto _: state)
+        algo.run(src, dst);
+    size_t allocs = allocations - before;
+
+    state.counters["pixels/s"] = benchmark::Counter(src.total(), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["allocs"] = benchmark::Counter(allocs, benchmark::Counter::kAvgIterations);
+    state.counters["peakRSS_MB"] = peakRSSMB();
+}
+
+static void checkSteadyState(benchmark::State &state, const vector<Algorithm> &algorithms,
+                             const vector<Frame> &frames) {
+    int threads = getNumThreads();
+    setNumThreads(1);
+
+    size_t worst = 0;
+    string culprit;
+    for (auto _: state)
+        for (const Algorithm &algo: algorithms)
+            for (const Frame &frame: frames) {
+                Mat src = frame.img, dst;
+                algo.run(src, dst);
+
+                size_t before = allocations;
+                algo.run(src, dst);
+                size_t allocs = allocations - before;
+                if (allocs > worst) {
+                    worst = allocs;
+                    culprit = string(algo.name) + "/" + frame.name;
+                }
+            }
+    setNumThreads(threads);
+
+    state.counters["allocs"] = worst;
+    if (worst > 0)
+        state.SkipWithError(("allocazioni a regime in " + culprit).c_str());
+}
+
+int main(int argc, char **argv) {
+    vector<char *> args(argv, argv + argc);
+    string jsonOut = "--benchmark_out=benchmark.json";
+    if (none_of(args.begin(), args.end(), [](const char *a) { return strncmp(a, "--benchmark_out=", 16) == 0; }))
+        args.push_back(&jsonOut[0]);
+
+    int nArgs = (int) args.size();
+    benchmark::Initialize(&nArgs, args.data());
+    string dir = nArgs > 1 ? args[1] : "../immagini";
+
+    vector<Frame> frames;
+    const char *images[] = {"fiore", "foglia", "monete", "splash", "strada"};
+    for (const char *name: images) {
+        Mat img = imread(dir + "/" + name + ".png", IMREAD_GRAYSCALE);
+        if (!img.empty())
+            frames.push_back({name, img});
+    }
+    const Size sizes[] = {Size(256, 256), Size(512, 512), Size(1024, 1024), Size(1920, 1080), Size(3840, 2160)};
+    for (Size s: sizes)
+        frames.push_back({to_string(s.width) + "x" + to_string(s.height), synthetic(s.height, s.width)});
+
+    const vector<Algorithm> algorithms = {
+        {"canny", INT_MAX, [](Mat &src, Mat &dst) { canny(src, dst, 20, 150); }},
+        {"canny_fused", INT_MAX, [](Mat &src, Mat &dst) { canny_fused(src, dst, 20, 150); }},
+        {"canny_fused_ws", INT_MAX, [](Mat &src, Mat &dst) {
+            static thread_local Workspace ws;
+            canny_fused(src, dst, 20, 150, &ws);
+        }},
+        {"harris", INT_MAX, [](Mat &src, Mat &dst) { harris(src, dst, 0.017f, 117); }},
+        {"harris_keypoints", INT_MAX, [](Mat &src, Mat &) {
+            static thread_local vector<KeyPoint> corners;
+            harris_keypoints(src, corners, 0.017f, 117);
+        }},
+        {"harris_keypoints_ws", INT_MAX, [](Mat &src, Mat &) {
+            static thread_local vector<KeyPoint> corners;
+            static thread_local Workspace ws;
+            harris_keypoints(src, corners, 0.017f, 117, 3, 0, &ws);
+        }},
+        {"hough_lines", INT_MAX, [](Mat &src, Mat &dst) { hough_lines(src, dst, 150); }},
+        {"hough_lines_parallel", INT_MAX, [](Mat &src, Mat &dst) { hough_lines_parallel(src, dst, 150, 20); }},
+        {"hough_lines_probabilistic", INT_MAX, [](Mat &src, Mat &) {
+            static thread_local vector<Vec4i> segments;
+            hough_lines_probabilistic(src, segments, 150, 30, 10);
+        }},
+        {"hough_lines_edgelist", INT_MAX, [](Mat &src, Mat &dst) {
+            static thread_local EdgeList edges;
+            static thread_local vector<Vec2f> lines;
+            canny_fused(src, dst, 20, 150, nullptr, &edges);
+            hough_lines_detect(edges, lines, 150, 20);
+        }},
+        {"hough_circles", 512, [](Mat &src, Mat &dst) { hough_circles(src, dst, 175, 20, 70); }},
+        {"hough_circles_parallel", INT_MAX, [](Mat &src, Mat &dst) { hough_circles_parallel(src, dst, 175, 20, 70); }},
+        {"hough_circles_gradient", INT_MAX, [](Mat &src, Mat &dst) { hough_circles_gradient(src, dst, 175, 20, 70); }},
+        {"hough_circles_edgelist", INT_MAX, [](Mat &src, Mat &dst) {
+            static thread_local EdgeList edges;
+            static thread_local vector<Vec3i> circles;
+            canny_fused(src, dst, 20, 150, nullptr, &edges);
+            hough_circles_detect(edges, circles, 175, 20, 70);
+        }},
+        {"otsu", INT_MAX, [](Mat &src, Mat &dst) { otsu(src, dst); }},
+        {"otsu2k", INT_MAX, [](Mat &src, Mat &dst) { otsu2k(src, dst); }},
+        {"otsuMulti", INT_MAX, [](Mat &src, Mat &dst) {
+            static thread_local vector<int> thresholds;
+            otsuMulti(src, dst, 3, thresholds);
+        }},
+        {"kmeans", INT_MAX, [](Mat &src, Mat &dst) { kmeans(src, dst, 3); }},
+        {"kmeansHist", INT_MAX, [](Mat &src, Mat &dst) { kmeansHist(src, dst, 3); }},
+        {"kmeansHist_ws", INT_MAX, [](Mat &src, Mat &dst) {
+            static thread_local Workspace ws;
+            kmeansHist(src, dst, 3, &ws);
+        }},
+        {"kmeansColor", INT_MAX, [](Mat &src, Mat &dst) { kmeansColor(src, dst, 8); }},
+        {"kmeansColor_hamerly", INT_MAX, [](Mat &src, Mat &dst) { kmeansColor(src, dst, 8, false, 0, 0, true); }},
+        {"kmeansColor_minibatch", INT_MAX, [](Mat &src, Mat &dst) { kmeansColor(src, dst, 8, false, 0, 4096); }},
+        {"kmeansColor_ws", INT_MAX, [](Mat &src, Mat &dst) {
+            static thread_local Workspace ws;
+            kmeansColor(src, dst, 8, false, 0, 0, false, nullptr, &ws);
+        }},
+        {"regionGrowing", 1024, [](Mat &src, Mat &dst) { regionGrowing(src, dst); }},
+        {"regionGrowingScan", INT_MAX, [](Mat &src, Mat &dst) { regionGrowingScan(src, dst); }},
+        {"regionGrowingScan_ws", INT_MAX, [](Mat &src, Mat &dst) {
+            static thread_local Workspace ws;
+            regionGrowingScan(src, dst, nullptr, &ws);
+        }},
+        {"regionGrowingParallel", INT_MAX, [](Mat &src, Mat &dst) { regionGrowingParallel(src, dst); }},
+        {"SplitMerge", INT_MAX, [](Mat &src, Mat &dst) { SplitMergeSegment(src, dst); }},
+        {"pipeline", INT_MAX, [](Mat &src, Mat &dst) {
+            static thread_local Mat corners, circles;
+            canny(src, dst, 20, 150);
+            harris(src, corners, 0.017f, 117);
+            hough_circles_gradient(src, circles, 175, 20, 70);
+        }},
+        {"pipeline_ctx", INT_MAX, [](Mat &src, Mat &dst) {
+            static thread_local FrameContext ctx;
+            static thread_local Mat corners, circles;
+            ctx.reset(src);
+            canny(ctx, dst, 20, 150);
+            harris(ctx, corners, 0.017f, 117);
+            hough_circles_gradient(ctx, circles, 175, 20, 70);
+        }},
+    };
+
+    for (const Algorithm &algo: algorithms)
+        for (const Frame &frame: frames)
+            if (max(frame.img.rows, frame.img.cols) <= algo.maxSide)
+                benchmark::RegisterBenchmark((string(algo.name) + "/" + frame.name).c_str(), runAlgorithm, algo,
+                                             frame.img)
+                    ->Unit(benchmark::kMillisecond)
+                    ->UseRealTime();
+
+    vector<Algorithm> withWorkspace;
+    for (const Algorithm &algo: algorithms)
+        if (string(algo.name).find("_ws") != string::npos)
+            withWorkspace.push_back(algo);
+    benchmark::RegisterBenchmark("steady_state_allocs", checkSteadyState, withWorkspace, frames)->Iterations(1);
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
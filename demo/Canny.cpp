@@ -0,0 +1,19 @@
+#include "Algoritmi.h"
+using namespace std;
+using namespace cv;
+
+int main() {
+    Mat src = imread("../immagini/fiore.png", IMREAD_GRAYSCALE);
+
+    int cannyLTH = 20;
+    int cannyHTH = 150;
+
+    Mat dst, dstFused;
+    canny(src, dst, cannyLTH, cannyHTH);
+    canny_fused(src, dstFused, cannyLTH, cannyHTH);
+
+    imshow("Canny", dst);
+    imshow("Canny (fuso + isteresi)", dstFused);
+    waitKey(0);
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include "Algoritmi.h"
+#include <iostream>
+using namespace std;
+using namespace cv;
+
+int main() {
+    Mat src = imread("../immagini/foglia.png", IMREAD_GRAYSCALE);
+
+    float k = 0.017;
+    int threshTH = 117;
+
+    Mat dst, dstNMS;
+    vector<KeyPoint> corners;
+    harris(src, dst, k, threshTH);
+    harris_keypoints(src, corners, k, threshTH);
+    harris_draw(src, dstNMS, corners);
+    cout << "harris_keypoints: " << corners.size() << " angoli" << endl;
+
+    imshow("Harris", dst);
+    imshow("Harris (NMS)", dstNMS);
+    waitKey(0);
+
+    return 0;
+}
@@ -0,0 +1,23 @@
+#include "Algoritmi.h"
+using namespace std;
+using namespace cv;
+
+int main() {
+    Mat src = imread("../immagini/monete.png", IMREAD_GRAYSCALE);
+
+    int houghTH = 175;
+    int Rmin = 20;
+    int Rmax = 70;
+
+    Mat dst, dstParallel, dstGradient;
+    hough_circles(src, dst, houghTH, Rmin, Rmax);
+    hough_circles_parallel(src, dstParallel, houghTH, Rmin, Rmax);
+    hough_circles_gradient(src, dstGradient, houghTH, Rmin, Rmax);
+
+    imshow("Hough Circles", dst);
+    imshow("Hough Circles (parallelo)", dstParallel);
+    imshow("Hough Circles (gradiente + NMS)", dstGradient);
+    waitKey(0);
+
+    return 0;
+}
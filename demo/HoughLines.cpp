@@ -0,0 +1,31 @@
+#include "Algoritmi.h"
+#include <iostream>
+using namespace std;
+using namespace cv;
+
+int main() {
+    Mat src = imread("../immagini/strada.png", IMREAD_GRAYSCALE);
+
+    int houghTH = 150;
+    Mat dst, dstParallel;
+    hough_lines(src, dst, houghTH);
+    hough_lines_parallel(src, dstParallel, houghTH, 20);
+
+    vector<Vec2f> lines;
+    vector<Vec4i> segments;
+    hough_lines_detect(src, lines, houghTH, 20);
+    hough_lines_probabilistic(src, segments, 50, 30, 10);
+
+    cout << "hough_lines_probabilistic: " << segments.size() << " segmenti, recall "
+         << hough_lines_recall(lines, segments) << "/" << lines.size() << endl;
+
+    Mat dstSegments = src.clone();
+    for (const Vec4i &s: segments)
+        line(dstSegments, Point(s[0], s[1]), Point(s[2], s[3]), Scalar(0), 2);
+
+    imshow("HoughLines", dst);
+    imshow("HoughLines (parallelo, top 20)", dstParallel);
+    imshow("HoughLines (probabilistica)", dstSegments);
+    waitKey(0);
+    return 0;
+}
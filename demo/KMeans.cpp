@@ -0,0 +1,25 @@
+#include "Algoritmi.h"
+using namespace std;
+using namespace cv;
+
+int main() {
+    Mat src = imread("../immagini/splash.png", IMREAD_GRAYSCALE);
+
+    int k = 3;
+
+    Mat dst, dstHist;
+    kmeans(src, dst, k);
+    kmeansHist(src, dstHist, k);
+
+    Mat color = imread("../immagini/splash.png", IMREAD_COLOR), dstColor, dstSpatial;
+    kmeansColor(color, dstColor, 8, true);
+    kmeansColor(color, dstSpatial, 8, true, 0.5f);
+
+    imshow("K-means", dst);
+    imshow("K-means (istogramma)", dstHist);
+    imshow("K-means (Lab)", dstColor);
+    imshow("K-means (Lab + x, y)", dstSpatial);
+    waitKey(0);
+
+    return 0;
+}
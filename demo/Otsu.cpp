@@ -0,0 +1,15 @@
+#include "Algoritmi.h"
+using namespace std;
+using namespace cv;
+
+int main() {
+    Mat src = imread("../immagini/fiore.png", IMREAD_GRAYSCALE);
+
+    Mat dst;
+    otsu(src, dst);
+
+    imshow("Otsu", dst);
+    waitKey(0);
+
+    return 0;
+}
@@ -0,0 +1,28 @@
+#include "Algoritmi.h"
+#include <iostream>
+using namespace std;
+using namespace cv;
+
+int main() {
+    Mat src = imread("../immagini/fiore.png", IMREAD_GRAYSCALE);
+
+    Mat dst;
+    otsu2k(src, dst);
+    imshow("Otsu2k", dst);
+
+    for (int K = 2; K <= 4; K++) {
+        vector<int> thresholds;
+        Mat dstMulti;
+        otsuMulti(src, dstMulti, K, thresholds);
+
+        cout << "OtsuMulti K=" << K << ":";
+        for (int th: thresholds)
+            cout << " " << th;
+        cout << endl;
+
+        imshow("OtsuMulti K=" + to_string(K), dstMulti);
+    }
+    waitKey(0);
+
+    return 0;
+}
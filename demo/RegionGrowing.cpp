@@ -0,0 +1,21 @@
+#include "Algoritmi.h"
+#include <iostream>
+using namespace std;
+using namespace cv;
+
+int main() {
+    Mat src = imread("../immagini/splash.png", IMREAD_GRAYSCALE);
+
+    Mat dst, labels, dstScan;
+    vector<Rect> boxes;
+    regionGrowing(src, dst);
+    regionGrowingScan(src, labels, &boxes);
+    labels.convertTo(dstScan, CV_8U);
+    cout << "regionGrowingScan: " << boxes.size() << " regioni" << endl;
+
+    imshow("RegionGrowing", dst);
+    imshow("RegionGrowing (scanline)", dstScan);
+    waitKey(0);
+
+    return 0;
+}
@@ -0,0 +1,22 @@
+#include "Algoritmi.h"
+#include <iostream>
+using namespace std;
+using namespace cv;
+
+int main() {
+    Mat src = imread("../immagini/foglia.png", IMREAD_GRAYSCALE);
+
+    QuadTree tree;
+    Mat imgQuad, imgSeg, imgRAG;
+    int regions = SplitMerge(src, tree, imgQuad, imgSeg, imgRAG);
+
+    cout << "Quad Tree: " << tree.nodes.size() << " nodi, " << tree.bytes() << " byte" << endl;
+    cout << "RAG: " << regions << " regioni" << endl;
+
+    imshow("Quad Tree", imgQuad);
+    imshow("Segmented", imgSeg);
+    imshow("Segmented (RAG)", imgRAG);
+    waitKey(0);
+
+    return 0;
+}
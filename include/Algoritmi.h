@@ -0,0 +1,270 @@
+#ifndef ALGORITMI_H
+#define ALGORITMI_H
+
+#include <opencv2/opencv.hpp>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <typeinfo>
+#include <vector>
+
+// Le versioni con "Mat &out" scrivono nel buffer del chiamante con Mat::create, quindi
+// richiamandole su frame della stessa dimensione l'output non viene riallocato.
+
+// Buffer di lavoro riutilizzabili tra un frame e l'altro, identificati per nome e per task
+// (una banda o un thread di parallel_for_). Dal secondo frame della stessa risoluzione le
+// funzioni che ricevono un Workspace non allocano piu' memoria. Il nome viene confrontato per
+// contenuto; ogni nome di vec() deve essere usato con un solo tipo.
+class Workspace {
+public:
+    Workspace() = default;
+    Workspace(const Workspace &) = delete;
+    Workspace &operator=(const Workspace &) = delete;
+
+    cv::Mat &mat(const char *name, int rows, int cols, int type, int task = 0) {
+        cv::Mat &m = find(pool(task).mats, name).mat;
+        m.create(rows, cols, type);
+        return m;
+    }
+
+    template<typename T>
+    std::vector<T> &vec(const char *name, size_t n, int task = 0) {
+        Entry &e = find(pool(task).vecs, name);
+        if (!e.vec) {
+            e.vec = std::make_shared<std::vector<T>>();
+            e.type = &typeid(std::vector<T>);
+        }
+        CV_Assert(*e.type == typeid(std::vector<T>));
+        std::vector<T> &v = *static_cast<std::vector<T> *>(e.vec.get());
+        v.resize(n);
+        return v;
+    }
+
+    // Da chiamare prima di parallel_for_: i task possono poi usare il proprio pool in parallelo.
+    void reserve(int tasks) {
+        while ((int) pools.size() < tasks)
+            pools.emplace_back(new Pool());
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        cv::Mat mat;
+        std::shared_ptr<void> vec;
+        const std::type_info *type = nullptr;
+    };
+    struct Pool {
+        std::deque<Entry> mats, vecs;
+    };
+    std::vector<std::unique_ptr<Pool>> pools;
+
+    Pool &pool(int task) {
+        reserve(task + 1);
+        return *pools[task];
+    }
+
+    static Entry &find(std::deque<Entry> &entries, const char *name) {
+        for (Entry &e: entries)
+            if (e.name == name)
+                return e;
+        entries.emplace_back();
+        entries.back().name = name;
+        return entries.back();
+    }
+};
+
+// Punti di bordo in forma compatta (x = colonna, y = riga) con la direzione del gradiente in
+// gradi [0, 360); degrees e' vuoto se la direzione non e' nota. size e' la dimensione del frame.
+struct EdgeList {
+    cv::Size size;
+    std::vector<cv::Point> points;
+    std::vector<int> degrees;
+};
+
+// Intermedi di un frame calcolati al primo uso e condivisi tra gli algoritmi, indicizzati per
+// dimensione del kernel gaussiano e sigma (ksize <= 1 indica l'immagine senza sfocatura).
+// reset() passa al frame successivo riusando i buffer gia' allocati.
+class FrameContext {
+public:
+    FrameContext() {}
+    explicit FrameContext(const cv::Mat &frame) { reset(frame); }
+
+    void reset(const cv::Mat &frame);
+    const cv::Mat &image() const { return input; }
+
+    const cv::Mat &blurred(int ksize, double sigma);
+    const cv::Mat &dx(int ksize, double sigma);
+    const cv::Mat &dy(int ksize, double sigma);
+    const cv::Mat &magnitude(int ksize, double sigma);
+    const cv::Mat &direction(int ksize, double sigma);
+    const cv::Mat &edges(int ksize, double sigma, double low, double high);
+
+private:
+    typedef std::tuple<int, int, double, double, double> Key;
+    struct Entry {
+        cv::Mat mat;
+        bool valid = false;
+    };
+
+    cv::Mat input;
+    std::map<Key, Entry> cache;
+
+    Entry &entry(int what, int ksize, double sigma, double low = 0, double high = 0) {
+        return cache[Key(what, ksize, sigma, low, high)];
+    }
+};
+
+// Canny
+extern bool cannySimd;
+extern bool cannyParallel;
+
+void canny(FrameContext &ctx, cv::Mat &out, int cannyLTH, int cannyHTH, EdgeList *edges = nullptr);
+void canny(cv::Mat &input, cv::Mat &out, int cannyLTH, int cannyHTH, EdgeList *edges = nullptr);
+cv::Mat canny(cv::Mat &input, int cannyLTH, int cannyHTH);
+void canny_fused(cv::Mat &input, cv::Mat &out, int cannyLTH, int cannyHTH, Workspace *ws = nullptr,
+                 EdgeList *edges = nullptr);
+cv::Mat canny_fused(cv::Mat &input, int cannyLTH, int cannyHTH);
+void edgeList(const cv::Mat &edges, EdgeList &list, const cv::Mat &Dx = cv::Mat(), const cv::Mat &Dy = cv::Mat());
+
+// Harris
+void harris(FrameContext &ctx, cv::Mat &out, float k, int threshTH);
+void harris(cv::Mat &input, cv::Mat &out, float k, int threshTH);
+cv::Mat harris(cv::Mat &input, float k, int threshTH);
+void harris_keypoints(cv::Mat &input, std::vector<cv::KeyPoint> &corners, float k, int threshTH, int nmsSize = 3,
+                      int topN = 0, Workspace *ws = nullptr);
+std::vector<cv::KeyPoint> harris_keypoints(cv::Mat &input, float k, int threshTH, int nmsSize = 3, int topN = 0);
+void harris_draw(cv::Mat &input, cv::Mat &out, const std::vector<cv::KeyPoint> &corners);
+cv::Mat harris_draw(cv::Mat &input, const std::vector<cv::KeyPoint> &corners);
+
+// Hough (rette)
+void hough_lines(FrameContext &ctx, cv::Mat &out, int houghTH);
+void hough_lines(cv::Mat &input, cv::Mat &out, int houghTH);
+cv::Mat hough_lines(cv::Mat &input, int houghTH);
+void hough_lines_detect(const EdgeList &edges, std::vector<cv::Vec2f> &lines, int houghTH, int topN = 0,
+                        int nTheta = 180);
+void hough_lines_detect(FrameContext &ctx, std::vector<cv::Vec2f> &lines, int houghTH, int topN = 0, int nTheta = 180);
+void hough_lines_detect(cv::Mat &input, std::vector<cv::Vec2f> &lines, int houghTH, int topN = 0, int nTheta = 180);
+std::vector<cv::Vec2f> hough_lines_detect(cv::Mat &input, int houghTH, int topN = 0, int nTheta = 180);
+void hough_lines_parallel(FrameContext &ctx, cv::Mat &out, int houghTH, int topN = 0, int nTheta = 180);
+void hough_lines_parallel(cv::Mat &input, cv::Mat &out, int houghTH, int topN = 0, int nTheta = 180);
+cv::Mat hough_lines_parallel(cv::Mat &input, int houghTH, int topN = 0, int nTheta = 180);
+void hough_lines_probabilistic(const EdgeList &edges, std::vector<cv::Vec4i> &segments, int houghTH, int minLength,
+                               int maxGap, int nTheta = 180);
+void hough_lines_probabilistic(FrameContext &ctx, std::vector<cv::Vec4i> &segments, int houghTH, int minLength,
+                               int maxGap, int nTheta = 180);
+void hough_lines_probabilistic(cv::Mat &input, std::vector<cv::Vec4i> &segments, int houghTH, int minLength,
+                               int maxGap, int nTheta = 180);
+std::vector<cv::Vec4i> hough_lines_probabilistic(cv::Mat &input, int houghTH, int minLength, int maxGap,
+                                                 int nTheta = 180);
+// Numero di rette di lines coperte da almeno un segmento con entrambi gli estremi entro tol pixel
+int hough_lines_recall(const std::vector<cv::Vec2f> &lines, const std::vector<cv::Vec4i> &segments, double tol = 3);
+
+// Hough (cerchi)
+void hough_circles(FrameContext &ctx, cv::Mat &out, int houghTH, int Rmin, int Rmax);
+void hough_circles(cv::Mat &input, cv::Mat &out, int houghTH, int Rmin, int Rmax);
+cv::Mat hough_circles(cv::Mat &input, int houghTH, int Rmin, int Rmax);
+void hough_circles_parallel(FrameContext &ctx, cv::Mat &out, int houghTH, int Rmin, int Rmax, bool compact = true,
+                            size_t *accBytes = nullptr);
+void hough_circles_parallel(cv::Mat &input, cv::Mat &out, int houghTH, int Rmin, int Rmax, bool compact = true,
+                            size_t *accBytes = nullptr);
+cv::Mat hough_circles_parallel(cv::Mat &input, int houghTH, int Rmin, int Rmax, bool compact = true,
+                               size_t *accBytes = nullptr);
+// Accumula i voti a blocchi di 256x256 pixel e solo nei blocchi raggiungibili dai punti di bordo.
+// nmsSize e' il lato della finestra (x, y, raggio) di soppressione dei non massimi, come in harris_keypoints
+void hough_circles_detect(const EdgeList &edges, std::vector<cv::Vec3i> &circles, int houghTH, int Rmin, int Rmax,
+                          int spread = 15, int nmsSize = 11);
+void hough_circles_gradient(FrameContext &ctx, cv::Mat &out, int houghTH, int Rmin, int Rmax, int spread = 15,
+                            int nmsSize = 11);
+void hough_circles_gradient(cv::Mat &input, cv::Mat &out, int houghTH, int Rmin, int Rmax, int spread = 15,
+                            int nmsSize = 11);
+cv::Mat hough_circles_gradient(cv::Mat &input, int houghTH, int Rmin, int Rmax, int spread = 15, int nmsSize = 11);
+
+// Otsu
+void otsu(cv::Mat &input, cv::Mat &out);
+cv::Mat otsu(cv::Mat &input);
+void otsu2k(cv::Mat &input, cv::Mat &out);
+cv::Mat otsu2k(cv::Mat &input);
+// K soglie (1..255); se l'immagine ha meno di K+1 livelli distinti ne restituisce meno
+void otsuMulti(cv::Mat &input, cv::Mat &out, int K, std::vector<int> &thresholds);
+cv::Mat otsuMulti(cv::Mat &input, int K, std::vector<int> &thresholds);
+
+// K-means
+void kmeans(cv::Mat &input, cv::Mat &out, int k);
+cv::Mat kmeans(cv::Mat &input, int k);
+void kmeansHist(cv::Mat &input, cv::Mat &out, int k, Workspace *ws = nullptr);
+cv::Mat kmeansHist(cv::Mat &input, int k);
+
+// K-means su immagini a colori (BGR o Lab) o in scala di grigi, con le coordinate x, y come
+// caratteristiche aggiuntive se spatialWeight > 0. batchSize > 0 usa la variante mini-batch
+// e un solo passaggio finale di assegnazione su tutta l'immagine. hamerly = true mantiene per ogni
+// pixel un limite superiore e uno inferiore sulle distanze dai centroidi e salta i confronti
+// inutili: il risultato e' identico a Lloyd e skipped riporta le distanze non calcolate.
+extern bool kmeansSimd;
+
+void kmeansColor(cv::Mat &input, cv::Mat &out, int k, bool lab = false, float spatialWeight = 0, int batchSize = 0,
+                 bool hamerly = false, size_t *skipped = nullptr, Workspace *ws = nullptr);
+cv::Mat kmeansColor(cv::Mat &input, int k, bool lab = false, float spatialWeight = 0, int batchSize = 0,
+                    bool hamerly = false);
+
+// Region growing
+void regionGrowing(cv::Mat &input, cv::Mat &labels);
+cv::Mat regionGrowing(cv::Mat &input);
+void regionGrowingScan(cv::Mat &input, cv::Mat &labels, std::vector<cv::Rect> *boxes = nullptr,
+                       Workspace *ws = nullptr);
+cv::Mat regionGrowingScan(cv::Mat &input, std::vector<cv::Rect> *boxes = nullptr);
+void regionGrowingParallel(cv::Mat &input, cv::Mat &labels, std::vector<cv::Rect> *boxes = nullptr);
+cv::Mat regionGrowingParallel(cv::Mat &input, std::vector<cv::Rect> *boxes = nullptr);
+
+// Split & Merge
+extern double smTH;
+extern int tSize;
+extern int mTH;
+// Profondita' del quadtree a cui lo split crea i task paralleli (<= 0: split seriale)
+extern int parallelDepth;
+
+class TNode {
+public:
+    cv::Rect region;
+    int regions[4] = {-1, -1, -1, -1};
+    int mergedStart = 0, mergedCount = 0;
+    bool isMerged[4] = {false};
+    double stddev, mean;
+
+    TNode(cv::Rect R) : region(R) {}
+};
+
+class QuadTree {
+public:
+    std::vector<TNode> nodes;
+    std::vector<int> merged;
+    std::vector<std::vector<TNode>> taskNodes;
+    cv::Mat sum, sqsum, leafIds;
+
+    void reset() {
+        nodes.clear();
+        merged.clear();
+        for (auto &task: taskNodes)
+            task.clear();
+    }
+
+    size_t bytes() const {
+        size_t total = nodes.capacity() * sizeof(TNode) + merged.capacity() * sizeof(int) +
+                       (sum.total() + sqsum.total()) * sizeof(double) + leafIds.total() * sizeof(int);
+        for (const auto &task: taskNodes)
+            total += task.capacity() * sizeof(TNode);
+        return total;
+    }
+};
+
+int split(QuadTree &tree, cv::Rect R);
+void drawQuadTree(const QuadTree &tree, cv::Mat &img);
+void merge(QuadTree &tree, int r);
+void segment(QuadTree &tree, int r, cv::Mat &img);
+int mergeRegions(QuadTree &tree, cv::Mat &img);
+int SplitMerge(cv::Mat &input, QuadTree &tree, cv::Mat &imgQuad, cv::Mat &imgSeg, cv::Mat &imgRAG);
+void SplitMergeSegment(cv::Mat &input, cv::Mat &out);
+cv::Mat SplitMergeSegment(cv::Mat &input);
+
+#endif
@@ -1,23 +1,23 @@
-#include <opencv2/opencv.hpp>
+#include "Algoritmi.h"
+#include <climits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CANNY_SIMD
+#include <immintrin.h>
+#endif
+
 using namespace std;
 using namespace cv;
 
-Mat canny(Mat &input, int cannyLTH, int cannyHTH) {
-    Mat img = input.clone();
-    GaussianBlur(img, img, Size(3, 3), 1, 1);
-
-    Mat Dx, Dy;
-    Sobel(img, Dx, CV_32F, 1, 0);
-    Sobel(img, Dy, CV_32F, 0, 1);
+bool cannySimd = true;
+bool cannyParallel = true;
 
-    Mat Dx2, Dy2, magnitude;
-    multiply(Dx, Dx, Dx2);
-    multiply(Dy, Dy, Dy2);
-    sqrt(Dx2 + Dy2, magnitude);
+static const int TG22 = 13573;
 
-    normalize(magnitude, magnitude, 0, 255, NORM_MINMAX, CV_8U);
-    Mat phase;
-    cv::phase(Dx, Dy, phase);
+void canny(FrameContext &ctx, Mat &out, int cannyLTH, int cannyHTH, EdgeList *edges) {
+    Mat magnitude;
+    normalize(ctx.magnitude(3, 1), magnitude, 0, 255, NORM_MINMAX, CV_8U);
+    const Mat &phase = ctx.direction(3, 1);
 
     Mat NMS = Mat::zeros(magnitude.size(), CV_8U);
     for (int x = 1; x < magnitude.rows; x++)
@@ -46,24 +46,520 @@ Mat canny(Mat &input, int cannyLTH, int cannyHTH) {
                 NMS.at<uchar>(x, y) = curr;
         }
 
-    Mat out = Mat::zeros(NMS.size(), CV_8U);
+    out.create(NMS.size(), CV_8U);
+    out.setTo(0);
+    if (edges) {
+        edges->size = NMS.size();
+        edges->points.clear();
+        edges->degrees.clear();
+    }
     for (int x = 1; x < NMS.rows; x++)
         for (int y = 1; y < NMS.cols; y++)
-            if (NMS.at<uchar>(x, y) > cannyLTH && NMS.at<uchar>(x, y) < cannyHTH)
+            if (NMS.at<uchar>(x, y) > cannyLTH && NMS.at<uchar>(x, y) < cannyHTH) {
                 out.at<uchar>(x, y) = 255;
+                if (edges) {
+                    edges->points.push_back(Point(y, x));
+                    edges->degrees.push_back(cvRound(phase.at<float>(x, y) * 180 / CV_PI) % 360);
+                }
+            }
+}
 
+void canny(Mat &input, Mat &out, int cannyLTH, int cannyHTH, EdgeList *edges) {
+    FrameContext ctx(input);
+    canny(ctx, out, cannyLTH, cannyHTH, edges);
+}
+
+Mat canny(Mat &input, int cannyLTH, int cannyHTH) {
+    Mat out;
+    canny(input, out, cannyLTH, cannyHTH);
     return out;
 }
 
-int main() {
-    Mat src = imread("../immagini/fiore.png", IMREAD_GRAYSCALE);
+static void blurRow(const uchar *r0, const uchar *r1, const uchar *r2, int w0, int w1, int *tmp, uchar *dst,
+                    int cols) {
+    for (int c = 0; c < cols; c++)
+        tmp[c + 1] = w0 * (r0[c] + r2[c]) + w1 * r1[c];
+    tmp[0] = tmp[2];
+    tmp[cols + 1] = tmp[cols - 1];
+
+    for (int c = 0; c < cols; c++)
+        dst[c + 1] = (uchar) ((w0 * (tmp[c] + tmp[c + 2]) + w1 * tmp[c + 1] + (1 << 15)) >> 16);
+    dst[0] = dst[2];
+    dst[cols + 1] = dst[cols - 1];
+}
+
+static void sobelScalar(const uchar *b0, const uchar *b1, const uchar *b2, short *dx, short *dy, int *mag, int c,
+                        int cols) {
+    for (; c < cols; c++) {
+        int gx = (b0[c + 2] - b0[c]) + 2 * (b1[c + 2] - b1[c]) + (b2[c + 2] - b2[c]);
+        int gy = (b2[c] + 2 * b2[c + 1] + b2[c + 2]) - (b0[c] + 2 * b0[c + 1] + b0[c + 2]);
+        dx[c] = (short) gx;
+        dy[c] = (short) gy;
+        mag[c] = gx * gx + gy * gy;
+    }
+}
 
-    int cannyLTH = 20;
-    int cannyHTH = 150;
+static void nmsScalar(const int *m0, const int *m1, const int *m2, const short *dx, const short *dy, int *out, int c,
+                      int end) {
+    for (; c < end; c++) {
+        int m = m1[c];
+        out[c] = 0;
+        if (m == 0)
+            continue;
+
+        int ax = abs(dx[c]), ay = abs(dy[c]);
+        int tg22x = ax * TG22;
+        int y15 = ay << 15;
+
+        bool keep;
+        if (y15 < tg22x)
+            keep = m > m1[c - 1] && m >= m1[c + 1];
+        else if (y15 > tg22x + (ax << 16))
+            keep = m > m0[c] && m >= m2[c];
+        else if ((dx[c] ^ dy[c]) < 0)
+            keep = m > m0[c + 1] && m >= m2[c - 1];
+        else
+            keep = m > m0[c - 1] && m >= m2[c + 1];
+
+        if (keep)
+            out[c] = m;
+    }
+}
+
+#ifdef CANNY_SIMD
+__attribute__((target("avx2")))
+static int sobelAVX2(const uchar *b0, const uchar *b1, const uchar *b2, short *dx, short *dy, int *mag, int cols) {
+    int c = 0;
+    for (; c + 16 <= cols; c += 16) {
+        __m256i l0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b0 + c)));
+        __m256i c0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b0 + c + 1)));
+        __m256i r0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b0 + c + 2)));
+        __m256i l1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b1 + c)));
+        __m256i r1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b1 + c + 2)));
+        __m256i l2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b2 + c)));
+        __m256i c2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b2 + c + 1)));
+        __m256i r2 = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (b2 + c + 2)));
+
+        __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(r0, l0), _mm256_sub_epi16(r2, l2)),
+                                      _mm256_slli_epi16(_mm256_sub_epi16(r1, l1), 1));
+        __m256i gy = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(l2, r2), _mm256_slli_epi16(c2, 1)),
+                                      _mm256_add_epi16(_mm256_add_epi16(l0, r0), _mm256_slli_epi16(c0, 1)));
+        _mm256_storeu_si256((__m256i *) (dx + c), gx);
+        _mm256_storeu_si256((__m256i *) (dy + c), gy);
+
+        __m256i lo = _mm256_unpacklo_epi16(gx, gy);
+        __m256i hi = _mm256_unpackhi_epi16(gx, gy);
+        __m256i m0 = _mm256_madd_epi16(_mm256_permute2x128_si256(lo, hi, 0x20),
+                                       _mm256_permute2x128_si256(lo, hi, 0x20));
+        __m256i m1 = _mm256_madd_epi16(_mm256_permute2x128_si256(lo, hi, 0x31),
+                                       _mm256_permute2x128_si256(lo, hi, 0x31));
+        _mm256_storeu_si256((__m256i *) (mag + c), m0);
+        _mm256_storeu_si256((__m256i *) (mag + c + 8), m1);
+    }
+    return c;
+}
+
+__attribute__((target("sse4.1")))
+static int sobelSSE41(const uchar *b0, const uchar *b1, const uchar *b2, short *dx, short *dy, int *mag, int cols) {
+    int c = 0;
+    for (; c + 8 <= cols; c += 8) {
+        __m128i l0 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (b0 + c)));
+        __m128i c0 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (b0 + c + 1)));
+        __m128i r0 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (b0 + c + 2)));
+        __m128i l1 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (b1 + c)));
+        __m128i r1 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (b1 + c + 2)));
+        __m128i l2 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (b2 + c)));
+        __m128i c2 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (b2 + c + 1)));
+        __m128i r2 = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (b2 + c + 2)));
+
+        __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(r0, l0), _mm_sub_epi16(r2, l2)),
+                                   _mm_slli_epi16(_mm_sub_epi16(r1, l1), 1));
+        __m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(l2, r2), _mm_slli_epi16(c2, 1)),
+                                   _mm_add_epi16(_mm_add_epi16(l0, r0), _mm_slli_epi16(c0, 1)));
+        _mm_storeu_si128((__m128i *) (dx + c), gx);
+        _mm_storeu_si128((__m128i *) (dy + c), gy);
+
+        __m128i lo = _mm_unpacklo_epi16(gx, gy);
+        __m128i hi = _mm_unpackhi_epi16(gx, gy);
+        _mm_storeu_si128((__m128i *) (mag + c), _mm_madd_epi16(lo, lo));
+        _mm_storeu_si128((__m128i *) (mag + c + 4), _mm_madd_epi16(hi, hi));
+    }
+    return c;
+}
 
-    Mat dst = canny(src, cannyLTH, cannyHTH);
+__attribute__((target("avx2")))
+static int nmsAVX2(const int *m0, const int *m1, const int *m2, const short *dx, const short *dy, int *out, int end) {
+    const __m256i tg22 = _mm256_set1_epi32(TG22);
+    int c = 1;
+    for (; c + 8 <= end; c += 8) {
+        __m256i m = _mm256_loadu_si256((const __m256i *) (m1 + c));
+        __m256i gx = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (dx + c)));
+        __m256i gy = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (dy + c)));
 
-    imshow("Canny", dst);
-    waitKey(0);
+        __m256i ax = _mm256_abs_epi32(gx);
+        __m256i tg22x = _mm256_mullo_epi32(ax, tg22);
+        __m256i y15 = _mm256_slli_epi32(_mm256_abs_epi32(gy), 15);
+        __m256i horiz = _mm256_cmpgt_epi32(tg22x, y15);
+        __m256i vert = _mm256_cmpgt_epi32(y15, _mm256_add_epi32(tg22x, _mm256_slli_epi32(ax, 16)));
+        __m256i anti = _mm256_srai_epi32(_mm256_xor_si256(gx, gy), 31);
+
+        __m256i n1 = _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i *) (m0 + c - 1)),
+                                        _mm256_loadu_si256((const __m256i *) (m0 + c + 1)), anti);
+        __m256i n2 = _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i *) (m2 + c + 1)),
+                                        _mm256_loadu_si256((const __m256i *) (m2 + c - 1)), anti);
+        n1 = _mm256_blendv_epi8(n1, _mm256_loadu_si256((const __m256i *) (m0 + c)), vert);
+        n2 = _mm256_blendv_epi8(n2, _mm256_loadu_si256((const __m256i *) (m2 + c)), vert);
+        n1 = _mm256_blendv_epi8(n1, _mm256_loadu_si256((const __m256i *) (m1 + c - 1)), horiz);
+        n2 = _mm256_blendv_epi8(n2, _mm256_loadu_si256((const __m256i *) (m1 + c + 1)), horiz);
+
+        __m256i keep = _mm256_andnot_si256(_mm256_cmpgt_epi32(n2, m), _mm256_cmpgt_epi32(m, n1));
+        _mm256_storeu_si256((__m256i *) (out + c), _mm256_and_si256(m, keep));
+    }
+    return c;
+}
+
+__attribute__((target("sse4.1")))
+static int nmsSSE41(const int *m0, const int *m1, const int *m2, const short *dx, const short *dy, int *out, int end) {
+    const __m128i tg22 = _mm_set1_epi32(TG22);
+    int c = 1;
+    for (; c + 4 <= end; c += 4) {
+        __m128i m = _mm_loadu_si128((const __m128i *) (m1 + c));
+        __m128i gx = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *) (dx + c)));
+        __m128i gy = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *) (dy + c)));
+
+        __m128i ax = _mm_abs_epi32(gx);
+        __m128i tg22x = _mm_mullo_epi32(ax, tg22);
+        __m128i y15 = _mm_slli_epi32(_mm_abs_epi32(gy), 15);
+        __m128i horiz = _mm_cmpgt_epi32(tg22x, y15);
+        __m128i vert = _mm_cmpgt_epi32(y15, _mm_add_epi32(tg22x, _mm_slli_epi32(ax, 16)));
+        __m128i anti = _mm_srai_epi32(_mm_xor_si128(gx, gy), 31);
+
+        __m128i n1 = _mm_blendv_epi8(_mm_loadu_si128((const __m128i *) (m0 + c - 1)),
+                                     _mm_loadu_si128((const __m128i *) (m0 + c + 1)), anti);
+        __m128i n2 = _mm_blendv_epi8(_mm_loadu_si128((const __m128i *) (m2 + c + 1)),
+                                     _mm_loadu_si128((const __m128i *) (m2 + c - 1)), anti);
+        n1 = _mm_blendv_epi8(n1, _mm_loadu_si128((const __m128i *) (m0 + c)), vert);
+        n2 = _mm_blendv_epi8(n2, _mm_loadu_si128((const __m128i *) (m2 + c)), vert);
+        n1 = _mm_blendv_epi8(n1, _mm_loadu_si128((const __m128i *) (m1 + c - 1)), horiz);
+        n2 = _mm_blendv_epi8(n2, _mm_loadu_si128((const __m128i *) (m1 + c + 1)), horiz);
+
+        __m128i keep = _mm_andnot_si128(_mm_cmpgt_epi32(n2, m), _mm_cmpgt_epi32(m, n1));
+        _mm_storeu_si128((__m128i *) (out + c), _mm_and_si128(m, keep));
+    }
+    return c;
+}
+#endif
+
+static int simdLevel() {
+#ifdef CANNY_SIMD
+    static const int level = checkHardwareSupport(CV_CPU_AVX2) ? 2 : checkHardwareSupport(CV_CPU_SSE4_1) ? 1 : 0;
+    return cannySimd ? level : 0;
+#else
     return 0;
+#endif
+}
+
+static void sobelRow(const uchar *b0, const uchar *b1, const uchar *b2, short *dx, short *dy, int *mag, int cols) {
+    int c = 0;
+#ifdef CANNY_SIMD
+    if (simdLevel() == 2)
+        c = sobelAVX2(b0, b1, b2, dx, dy, mag, cols);
+    else if (simdLevel() == 1)
+        c = sobelSSE41(b0, b1, b2, dx, dy, mag, cols);
+#endif
+    sobelScalar(b0, b1, b2, dx, dy, mag, c, cols);
+}
+
+static void nmsRow(const int *m0, const int *m1, const int *m2, const short *dx, const short *dy, int *out, int cols) {
+    int c = 1;
+#ifdef CANNY_SIMD
+    if (simdLevel() == 2)
+        c = nmsAVX2(m0, m1, m2, dx, dy, out, cols - 1);
+    else if (simdLevel() == 1)
+        c = nmsSSE41(m0, m1, m2, dx, dy, out, cols - 1);
+#endif
+    nmsScalar(m0, m1, m2, dx, dy, out, c, cols - 1);
+    out[0] = out[cols - 1] = 0;
+}
+
+static void gradientNMS(const Mat &img, Mat &nms, Mat *deg, int &minMag, int &maxMag, Workspace &ws) {
+    int rows = img.rows, cols = img.cols;
+    nms.create(rows, cols, CV_32S);
+
+    static const int w0 = cvRound(getGaussianKernel(3, 1, CV_64F).at<double>(0) * 256);
+    const int w1 = 256 - 2 * w0;
+
+    vector<int> &tmp = ws.vec<int>("canny_fused.tmp", cols + 2);
+    vector<uchar> &blurred = ws.vec<uchar>("canny_fused.blurred", 3 * (cols + 2));
+    vector<short> &dx = ws.vec<short>("canny_fused.dx", 3 * cols);
+    vector<short> &dy = ws.vec<short>("canny_fused.dy", 3 * cols);
+    vector<int> &mag = ws.vec<int>("canny_fused.mag", 3 * cols);
+
+    auto inputRow = [&](int x) { return img.ptr<uchar>(x < 0 ? 1 : x >= rows ? rows - 2 : x); };
+    auto blurSlot = [&](int x) { return &blurred[(x % 3) * (cols + 2)]; };
+    auto magSlot = [&](int x) { return &mag[(x % 3) * cols]; };
+
+    for (int x = 0; x < 2; x++)
+        blurRow(inputRow(x - 1), inputRow(x), inputRow(x + 1), w0, w1, &tmp[0], blurSlot(x), cols);
+
+    minMag = INT_MAX;
+    maxMag = 0;
+    for (int x = 0; x < rows; x++) {
+        const uchar *up = blurSlot(x > 0 ? x - 1 : 1);
+        const uchar *down = blurSlot(x + 1 < rows ? x + 1 : x - 1);
+        int slot = x % 3;
+        sobelRow(up, blurSlot(x), down, &dx[slot * cols], &dy[slot * cols], magSlot(x), cols);
+        if (x + 2 < rows)
+            blurRow(inputRow(x + 1), inputRow(x + 2), inputRow(x + 3), w0, w1, &tmp[0], blurSlot(x + 2), cols);
+
+        const int *m = magSlot(x);
+        for (int c = 0; c < cols; c++) {
+            minMag = min(minMag, m[c]);
+            maxMag = max(maxMag, m[c]);
+        }
+
+        if (x >= 2) {
+            int prev = (x - 1) % 3;
+            nmsRow(magSlot(x - 2), magSlot(x - 1), m, &dx[prev * cols], &dy[prev * cols], nms.ptr<int>(x - 1), cols);
+
+            if (deg) {
+                const int *n = nms.ptr<int>(x - 1);
+                short *d = deg->ptr<short>(x - 1);
+                for (int c = 0; c < cols; c++)
+                    if (n[c])
+                        d[c] = (short) (cvRound(fastAtan2(dy[prev * cols + c], dx[prev * cols + c])) % 360);
+            }
+        }
+    }
+
+    fill(nms.ptr<int>(0), nms.ptr<int>(0) + cols, 0);
+    fill(nms.ptr<int>(rows - 1), nms.ptr<int>(rows - 1) + cols, 0);
+}
+
+static void classify(const Mat &nms, int low, int high, Mat &out, vector<Point> &stack, int xs, int xe) {
+    for (int x = xs; x < xe; x++) {
+        const int *m = nms.ptr<int>(x);
+        uchar *o = out.ptr<uchar>(x);
+        for (int y = 0; y < nms.cols; y++)
+            if (m[y] >= high) {
+                o[y] = 255;
+                stack.push_back(Point(y, x));
+            } else if (m[y] >= low)
+                o[y] = 1;
+            else
+                o[y] = 0;
+    }
+}
+
+template<typename Visit>
+static void trace(Mat &out, vector<Point> &stack, int xs, int xe, uchar from, uchar to, Visit visit) {
+    while (!stack.empty()) {
+        Point p = stack.back();
+        stack.pop_back();
+
+        for (int x = max(xs, p.y - 1); x <= min(xe - 1, p.y + 1); x++) {
+            uchar *o = out.ptr<uchar>(x);
+            for (int y = max(0, p.x - 1); y <= min(out.cols - 1, p.x + 1); y++)
+                if (o[y] == from) {
+                    o[y] = to;
+                    visit(Point(y, x));
+                    stack.push_back(Point(y, x));
+                }
+        }
+    }
+}
+
+static void clearWeak(Mat &out, int xs, int xe) {
+    for (int x = xs; x < xe; x++) {
+        uchar *o = out.ptr<uchar>(x);
+        for (int y = 0; y < out.cols; y++)
+            if (o[y] != 255)
+                o[y] = 0;
+    }
+}
+
+static void collectEdges(const Mat &out, const Mat &deg, EdgeList &edges) {
+    for (int x = 0; x < out.rows; x++) {
+        const uchar *o = out.ptr<uchar>(x);
+        for (int y = 0; y < out.cols; y++)
+            if (o[y]) {
+                edges.points.push_back(Point(y, x));
+                edges.degrees.push_back(deg.at<short>(x, y));
+            }
+    }
+}
+
+static void hysteresis(const Mat &nms, int low, int high, Mat &out, Workspace &ws) {
+    vector<Point> &stack = ws.vec<Point>("canny_fused.stack", 0);
+    classify(nms, low, high, out, stack, 0, nms.rows);
+    trace(out, stack, 0, out.rows, 1, 255, [](Point) {});
+    clearWeak(out, 0, out.rows);
+}
+
+static int findRoot(vector<int> &parent, int i) {
+    while (parent[i] != i)
+        i = parent[i] = parent[parent[i]];
+    return i;
+}
+
+static void hysteresisParallel(const Mat &nms, int low, int high, Mat &out, Workspace &ws) {
+    const uchar WEAK = 1, BORDER = 2, EDGE = 255;
+    int rows = nms.rows, cols = nms.cols;
+    int bandRows = max(8, rows / (4 * max(1, getNumThreads())));
+    int nBands = (rows + bandRows - 1) / bandRows;
+
+    vector<int> &borderLab = ws.vec<int>("canny_fused.borderLab", 2 * nBands * cols);
+    vector<int> &firstComp = ws.vec<int>("canny_fused.firstComp", nBands + 1);
+
+    ws.reserve(nBands);
+    auto local = [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++) {
+            int xs = b * bandRows, xe = min(rows, xs + bandRows);
+            vector<Point> &stack = ws.vec<Point>("canny_fused.stack", 0, b);
+            classify(nms, low, high, out, stack, xs, xe);
+            trace(out, stack, xs, xe, WEAK, EDGE, [](Point) {});
+
+            int *top = &borderLab[2 * b * cols], *bottom = top + cols, n = 0;
+            auto label = [&](Point p) {
+                if (p.y == xs)
+                    top[p.x] = n;
+                if (p.y == xe - 1)
+                    bottom[p.x] = n;
+            };
+            for (int side = 0; side < 2; side++) {
+                int x = side ? xe - 1 : xs;
+                uchar *o = out.ptr<uchar>(x);
+                for (int y = 0; y < cols; y++)
+                    if (o[y] == WEAK) {
+                        o[y] = BORDER;
+                        label(Point(y, x));
+                        stack.push_back(Point(y, x));
+                        trace(out, stack, xs, xe, WEAK, BORDER, label);
+                        n++;
+                    }
+            }
+            firstComp[b + 1] = n;
+        }
+    };
+    parallel_for_(Range(0, nBands), cref(local));
+
+    firstComp[0] = 0;
+    for (int b = 0; b < nBands; b++)
+        firstComp[b + 1] += firstComp[b];
+
+    vector<int> &parent = ws.vec<int>("canny_fused.parent", firstComp[nBands]);
+    vector<uchar> &strong = ws.vec<uchar>("canny_fused.strong", firstComp[nBands]);
+    for (int i = 0; i < firstComp[nBands]; i++) {
+        parent[i] = i;
+        strong[i] = 0;
+    }
+
+    for (int b = 1; b < nBands; b++) {
+        const uchar *below = out.ptr<uchar>(b * bandRows), *above = out.ptr<uchar>(b * bandRows - 1);
+        const int *labBelow = &borderLab[2 * b * cols], *labAbove = &borderLab[(2 * b - 1) * cols];
+        for (int y = 0; y < cols; y++) {
+            if (!below[y])
+                continue;
+            for (int ny = max(0, y - 1); ny <= min(cols - 1, y + 1); ny++) {
+                if (!above[ny] || (below[y] == EDGE && above[ny] == EDGE))
+                    continue;
+
+                if (below[y] == EDGE)
+                    strong[firstComp[b - 1] + labAbove[ny]] = 1;
+                else if (above[ny] == EDGE)
+                    strong[firstComp[b] + labBelow[y]] = 1;
+                else {
+                    int r1 = findRoot(parent, firstComp[b] + labBelow[y]);
+                    int r2 = findRoot(parent, firstComp[b - 1] + labAbove[ny]);
+                    parent[max(r1, r2)] = min(r1, r2);
+                }
+            }
+        }
+    }
+    for (int i = 0; i < firstComp[nBands]; i++)
+        if (strong[i])
+            strong[findRoot(parent, i)] = 1;
+    for (int i = 0; i < firstComp[nBands]; i++)
+        strong[i] = strong[findRoot(parent, i)];
+
+    auto stitch = [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++) {
+            int xs = b * bandRows, xe = min(rows, xs + bandRows);
+            vector<Point> &stack = ws.vec<Point>("canny_fused.stack", 0, b);
+            for (int side = 0; side < 2; side++) {
+                int x = side ? xe - 1 : xs;
+                const int *lab = &borderLab[(2 * b + side) * cols];
+                uchar *o = out.ptr<uchar>(x);
+                for (int y = 0; y < cols; y++)
+                    if (o[y] == BORDER && strong[firstComp[b] + lab[y]]) {
+                        o[y] = EDGE;
+                        stack.push_back(Point(y, x));
+                        trace(out, stack, xs, xe, BORDER, EDGE, [](Point) {});
+                    }
+            }
+            clearWeak(out, xs, xe);
+        }
+    };
+    parallel_for_(Range(0, nBands), cref(stitch));
+}
+
+void canny_fused(Mat &input, Mat &out, int cannyLTH, int cannyHTH, Workspace *ws, EdgeList *edges) {
+    out.create(input.size(), CV_8U);
+    if (edges) {
+        edges->size = input.size();
+        edges->points.clear();
+        edges->degrees.clear();
+    }
+    if (input.rows < 3 || input.cols < 3) {
+        out.setTo(0);
+        return;
+    }
+
+    Workspace local;
+    Workspace &w = ws ? *ws : local;
+    Mat &nms = w.mat("canny_fused.nms", input.rows, input.cols, CV_32S);
+    Mat *deg = edges ? &w.mat("canny_fused.deg", input.rows, input.cols, CV_16S) : nullptr;
+    int minMag, maxMag;
+    gradientNMS(input, nms, deg, minMag, maxMag, w);
+
+    double lo = sqrt((double) minMag), range = sqrt((double) maxMag) - lo;
+    if (range <= 0) {
+        out.setTo(0);
+        return;
+    }
+
+    double lowMag = lo + (cannyLTH + 0.5) * range / 255;
+    double highMag = lo + (cannyHTH + 0.5) * range / 255;
+
+    int low = cvCeil(lowMag * lowMag), high = cvCeil(highMag * highMag);
+    if (cannyParallel && getNumThreads() > 1)
+        hysteresisParallel(nms, low, high, out, w);
+    else
+        hysteresis(nms, low, high, out, w);
+
+    if (edges)
+        collectEdges(out, *deg, *edges);
+}
+
+Mat canny_fused(Mat &input, int cannyLTH, int cannyHTH) {
+    Mat out;
+    canny_fused(input, out, cannyLTH, cannyHTH);
+    return out;
+}
+
+void edgeList(const Mat &edges, EdgeList &list, const Mat &Dx, const Mat &Dy) {
+    list.size = edges.size();
+    list.points.clear();
+    list.degrees.clear();
+
+    bool withDegrees = !Dx.empty() && !Dy.empty();
+    for (int x = 0; x < edges.rows; x++) {
+        const uchar *row = edges.ptr<uchar>(x);
+        for (int y = 0; y < edges.cols; y++)
+            if (row[y] == 255) {
+                list.points.push_back(Point(y, x));
+                if (withDegrees)
+                    list.degrees.push_back(cvRound(fastAtan2(Dy.at<float>(x, y), Dx.at<float>(x, y))) % 360);
+            }
+    }
 }
@@ -0,0 +1,73 @@
+#include "Algoritmi.h"
+using namespace std;
+using namespace cv;
+
+enum { BLURRED, DX, DY, MAGNITUDE, DIRECTION, EDGES };
+
+void FrameContext::reset(const Mat &frame) {
+    input = frame;
+    for (auto &e: cache)
+        e.second.valid = false;
+}
+
+const Mat &FrameContext::blurred(int ksize, double sigma) {
+    if (ksize <= 1)
+        return input;
+
+    Entry &e = entry(BLURRED, ksize, sigma);
+    if (!e.valid) {
+        GaussianBlur(input, e.mat, Size(ksize, ksize), sigma, sigma);
+        e.valid = true;
+    }
+    return e.mat;
+}
+
+const Mat &FrameContext::dx(int ksize, double sigma) {
+    Entry &e = entry(DX, ksize, sigma);
+    if (!e.valid) {
+        Sobel(blurred(ksize, sigma), e.mat, CV_32F, 1, 0);
+        e.valid = true;
+    }
+    return e.mat;
+}
+
+const Mat &FrameContext::dy(int ksize, double sigma) {
+    Entry &e = entry(DY, ksize, sigma);
+    if (!e.valid) {
+        Sobel(blurred(ksize, sigma), e.mat, CV_32F, 0, 1);
+        e.valid = true;
+    }
+    return e.mat;
+}
+
+const Mat &FrameContext::magnitude(int ksize, double sigma) {
+    Entry &e = entry(MAGNITUDE, ksize, sigma);
+    if (!e.valid) {
+        const Mat &Dx = dx(ksize, sigma), &Dy = dy(ksize, sigma);
+        Mat Dy2;
+        multiply(Dx, Dx, e.mat);
+        multiply(Dy, Dy, Dy2);
+        e.mat += Dy2;
+        sqrt(e.mat, e.mat);
+        e.valid = true;
+    }
+    return e.mat;
+}
+
+const Mat &FrameContext::direction(int ksize, double sigma) {
+    Entry &e = entry(DIRECTION, ksize, sigma);
+    if (!e.valid) {
+        phase(dx(ksize, sigma), dy(ksize, sigma), e.mat);
+        e.valid = true;
+    }
+    return e.mat;
+}
+
+const Mat &FrameContext::edges(int ksize, double sigma, double low, double high) {
+    Entry &e = entry(EDGES, ksize, sigma, low, high);
+    if (!e.valid) {
+        Canny(blurred(ksize, sigma), e.mat, low, high);
+        e.valid = true;
+    }
+    return e.mat;
+}
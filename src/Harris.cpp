@@ -1,13 +1,10 @@
-#include <opencv2/opencv.hpp>
+#include "Algoritmi.h"
+#include <cfloat>
 using namespace std;
 using namespace cv;
 
-Mat harris(Mat &input, float k, int threshTH) {
-    Mat img = input.clone();
-
-    Mat Dx, Dy;
-    Sobel(img, Dx, CV_32F, 1, 0);
-    Sobel(img, Dy, CV_32F, 0, 1);
+void harris(FrameContext &ctx, Mat &out, float k, int threshTH) {
+    const Mat &Dx = ctx.dx(0, 0), &Dy = ctx.dy(0, 0);
 
     Mat Dx2, Dy2, DxDy;
     multiply(Dx, Dx, Dx2);
@@ -25,24 +22,166 @@ Mat harris(Mat &input, float k, int threshTH) {
     normalize(R, R, 0, 255, NORM_MINMAX, CV_8U);
     threshold(R, R, threshTH, 255, THRESH_BINARY);
 
-    Mat out = input.clone();
+    ctx.image().copyTo(out);
     for (int x = 0; x < R.rows; x++)
         for (int y = 0; y < R.cols; y++)
             if (R.at<uchar>(x, y) > 0)
                 circle(out, Point(y, x), 3, Scalar(0));
+}
+
+void harris(Mat &input, Mat &out, float k, int threshTH) {
+    FrameContext ctx(input);
+    harris(ctx, out, k, threshTH);
+}
 
+Mat harris(Mat &input, float k, int threshTH) {
+    Mat out;
+    harris(input, out, k, threshTH);
     return out;
 }
 
-int main() {
-    Mat src = imread("../immagini/foglia.png", IMREAD_GRAYSCALE);
+static void harrisBand(const Mat &img, float k, const float g[2], Mat &R, int y0, int y1, float &minR, float &maxR,
+                       vector<float> &ring, vector<float> &tmp) {
+    int rows = img.rows, cols = img.cols;
+    auto refl = [](int i, int n) { return i < 0 ? -i : i >= n ? 2 * n - i - 2 : i; };
+    auto slot = [&](int x) { return &ring[((x + 3) % 3) * 3 * cols]; };
+
+    auto products = [&](int x) {
+        int xr = refl(x, rows);
+        const uchar *p0 = img.ptr<uchar>(refl(xr - 1, rows));
+        const uchar *p1 = img.ptr<uchar>(xr);
+        const uchar *p2 = img.ptr<uchar>(refl(xr + 1, rows));
+        float *xx = &tmp[0], *yy = xx + cols + 2, *xy = yy + cols + 2;
+
+        auto sobel = [&](int y, int yl, int yr) {
+            float gx = (p0[yr] - p0[yl]) + 2 * (p1[yr] - p1[yl]) + (p2[yr] - p2[yl]);
+            float gy = (p2[yl] + 2 * p2[y] + p2[yr]) - (p0[yl] + 2 * p0[y] + p0[yr]);
+            xx[y + 1] = gx * gx;
+            yy[y + 1] = gy * gy;
+            xy[y + 1] = gx * gy;
+        };
+        sobel(0, 1, 1);
+        for (int y = 1; y < cols - 1; y++)
+            sobel(y, y - 1, y + 1);
+        sobel(cols - 1, cols - 2, cols - 2);
 
-    float k = 0.017;
-    int threshTH = 117;
-    Mat dst = harris(src, k, threshTH);
+        float *dst = slot(x);
+        for (int i = 0; i < 3; i++) {
+            float *src = &tmp[i * (cols + 2)];
+            src[0] = src[2];
+            src[cols + 1] = src[cols - 1];
+            for (int y = 0; y < cols; y++)
+                dst[i * cols + y] = g[0] * (src[y] + src[y + 2]) + g[1] * src[y + 1];
+        }
+    };
 
-    imshow("Harris", dst);
-    waitKey(0);
+    products(y0 - 1);
+    products(y0);
+    for (int x = y0; x < y1; x++) {
+        products(x + 1);
+        const float *a = slot(x - 1), *b = slot(x), *c = slot(x + 1);
+        float *out = R.ptr<float>(x);
 
-    return 0;
+        for (int y = 0; y < cols; y++) {
+            float sxx = g[0] * (a[y] + c[y]) + g[1] * b[y];
+            float syy = g[0] * (a[cols + y] + c[cols + y]) + g[1] * b[cols + y];
+            float sxy = g[0] * (a[2 * cols + y] + c[2 * cols + y]) + g[1] * b[2 * cols + y];
+
+            float trace = sxx + syy;
+            out[y] = sxx * syy - sxy * sxy - k * trace * trace;
+            minR = min(minR, out[y]);
+            maxR = max(maxR, out[y]);
+        }
+    }
+}
+
+static void harrisResponse(const Mat &img, float k, Mat &R, float &minR, float &maxR, Workspace &ws) {
+    R.create(img.size(), CV_32F);
+    static const Mat kernel = getGaussianKernel(3, 0.5, CV_32F);
+    const float g[2] = {kernel.at<float>(0), kernel.at<float>(1)};
+
+    int bandRows = max(16, img.rows / (4 * max(1, getNumThreads())));
+    int nBands = (img.rows + bandRows - 1) / bandRows;
+    vector<float> &bandMin = ws.vec<float>("harris.bandMin", nBands);
+    vector<float> &bandMax = ws.vec<float>("harris.bandMax", nBands);
+    fill(bandMin.begin(), bandMin.end(), FLT_MAX);
+    fill(bandMax.begin(), bandMax.end(), -FLT_MAX);
+
+    ws.reserve(nBands);
+    auto bands = [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++) {
+            vector<float> &ring = ws.vec<float>("harris.ring", 9 * img.cols, b);
+            vector<float> &tmp = ws.vec<float>("harris.tmp", 3 * (img.cols + 2), b);
+            harrisBand(img, k, g, R, b * bandRows, min(img.rows, (b + 1) * bandRows), bandMin[b], bandMax[b], ring,
+                       tmp);
+        }
+    };
+    parallel_for_(Range(0, nBands), cref(bands));
+
+    minR = *min_element(bandMin.begin(), bandMin.end());
+    maxR = *max_element(bandMax.begin(), bandMax.end());
+}
+
+void harris_keypoints(Mat &input, vector<KeyPoint> &corners, float k, int threshTH, int nmsSize, int topN,
+                      Workspace *ws) {
+    corners.clear();
+    if (input.rows < 3 || input.cols < 3)
+        return;
+
+    Workspace local;
+    Workspace &w = ws ? *ws : local;
+    Mat &R = w.mat("harris.R", input.rows, input.cols, CV_32F);
+    float minR, maxR;
+    harrisResponse(input, k, R, minR, maxR, w);
+    if (maxR <= minR)
+        return;
+
+    float th = minR + (threshTH + 0.5f) * (maxR - minR) / 255;
+    int h = nmsSize / 2;
+
+    for (int x = 0; x < R.rows; x++) {
+        const float *row = R.ptr<float>(x);
+        for (int y = 0; y < R.cols; y++) {
+            float v = row[y];
+            if (v <= th)
+                continue;
+
+            bool isMax = true;
+            for (int nx = max(0, x - h); isMax && nx <= min(R.rows - 1, x + h); nx++) {
+                const float *n = R.ptr<float>(nx);
+                for (int ny = max(0, y - h); isMax && ny <= min(R.cols - 1, y + h); ny++)
+                    if (n[ny] > v || (n[ny] == v && (nx < x || (nx == x && ny < y))))
+                        isMax = false;
+            }
+
+            if (isMax)
+                corners.push_back(KeyPoint(Point2f(y, x), 7.f, -1, v));
+        }
+    }
+
+    sort(corners.begin(), corners.end(), [](const KeyPoint &a, const KeyPoint &b) {
+        if (a.response != b.response)
+            return a.response > b.response;
+        return a.pt.y < b.pt.y || (a.pt.y == b.pt.y && a.pt.x < b.pt.x);
+    });
+    if (topN > 0 && (int) corners.size() > topN)
+        corners.resize(topN);
+}
+
+vector<KeyPoint> harris_keypoints(Mat &input, float k, int threshTH, int nmsSize, int topN) {
+    vector<KeyPoint> corners;
+    harris_keypoints(input, corners, k, threshTH, nmsSize, topN);
+    return corners;
+}
+
+void harris_draw(Mat &input, Mat &out, const vector<KeyPoint> &corners) {
+    input.copyTo(out);
+    for (const KeyPoint &kp: corners)
+        circle(out, Point(cvRound(kp.pt.x), cvRound(kp.pt.y)), 3, Scalar(0));
+}
+
+Mat harris_draw(Mat &input, const vector<KeyPoint> &corners) {
+    Mat out;
+    harris_draw(input, out, corners);
+    return out;
 }
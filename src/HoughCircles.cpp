@@ -1,12 +1,9 @@
-#include <opencv2/opencv.hpp>
+#include "Algoritmi.h"
 using namespace std;
 using namespace cv;
 
-Mat hough_circles(Mat &input, int houghTH, int Rmin, int Rmax) {
-    Mat img = input.clone();
-
-    GaussianBlur(img, img, Size(3, 3), 1, 1);
-    Canny(img, img, 100, 250);
+void hough_circles(FrameContext &ctx, Mat &out, int houghTH, int Rmin, int Rmax) {
+    const Mat &img = ctx.edges(3, 1, 100, 250);
 
     vector<vector<vector<int>>> votes(img.rows, vector<vector<int>>(img.cols, vector<int>(Rmax - Rmin + 1, 0)));
 
@@ -24,27 +21,265 @@ Mat hough_circles(Mat &input, int houghTH, int Rmin, int Rmax) {
                             votes[b][a][r - Rmin]++;
                     }
 
-    Mat out = input.clone();
+    ctx.image().copyTo(out);
     for (int b = 0; b < img.rows; b++)
         for (int a = 0; a < img.cols; a++)
             for (int r = Rmin; r < Rmax; r++)
                 if (votes[b][a][r - Rmin] > houghTH)
                     circle(out, Point(a, b), r, Scalar(0), 1);
+}
+
+void hough_circles(Mat &input, Mat &out, int houghTH, int Rmin, int Rmax) {
+    FrameContext ctx(input);
+    hough_circles(ctx, out, houghTH, Rmin, Rmax);
+}
+
+Mat hough_circles(Mat &input, int houghTH, int Rmin, int Rmax) {
+    Mat out;
+    hough_circles(input, out, houghTH, Rmin, Rmax);
+    return out;
+}
+
+template<typename T>
+static size_t voteCircles(const vector<Point> &edges, const vector<vector<Point>> &rings, int rows, int cols,
+                          vector<T> &votes) {
+    int nR = (int) rings.size();
+    size_t plane = (size_t) rows * cols;
+    votes.assign(nR * plane, 0);
+    if (votes.empty())
+        return 0;
+
+    size_t budget = 64 << 20, planeBytes = plane * sizeof(T);
+    int nThreads = (int) min<size_t>(max(1, getNumThreads()), max<size_t>(1, budget / planeBytes));
+    int tileR = nThreads > 1 ? (int) min<size_t>(nR, budget / (nThreads * planeBytes)) : max(nR, 1);
+    vector<T> partial(nThreads > 1 ? nThreads * tileR * plane : 0);
+    int chunk = ((int) edges.size() + nThreads - 1) / nThreads;
+
+    for (int r0 = 0; r0 < nR; r0 += tileR) {
+        int r1 = min(r0 + tileR, nR);
+        size_t tileSize = (r1 - r0) * plane;
+
+        parallel_for_(Range(0, nThreads), [&](const Range &range) {
+            for (int t = range.start; t < range.end; t++) {
+                T *acc = nThreads > 1 ? &partial[t * tileR * plane] : &votes[r0 * plane];
+                fill(acc, acc + tileSize, 0);
+
+                int e1 = min((int) edges.size(), (t + 1) * chunk);
+                for (int e = t * chunk; e < e1; e++)
+                    for (int r = r0; r < r1; r++) {
+                        T *accR = acc + (r - r0) * plane;
+                        for (const Point &d: rings[r]) {
+                            int a = edges[e].x + d.x;
+                            int b = edges[e].y + d.y;
+
+                            if (a >= 0 && a < cols && b >= 0 && b < rows)
+                                accR[b * cols + a]++;
+                        }
+                    }
+            }
+        }, nThreads);
+
+        if (nThreads == 1)
+            continue;
+        parallel_for_(Range(0, (r1 - r0) * rows), [&](const Range &range) {
+            for (int i = range.start; i < range.end; i++) {
+                T *dst = &votes[r0 * plane + (size_t) i * cols];
+                for (int t = 0; t < nThreads; t++) {
+                    const T *src = &partial[t * tileR * plane + (size_t) i * cols];
+                    for (int a = 0; a < cols; a++)
+                        dst[a] += src[a];
+                }
+            }
+        });
+    }
+
+    return (votes.size() + partial.size()) * sizeof(T);
+}
+
+static vector<vector<Point>> ringOffsets(int Rmin, int Rmax) {
+    vector<vector<Point>> rings(max(0, Rmax - Rmin), vector<Point>(360));
+    for (int r = Rmin; r < Rmax; r++)
+        for (int thetaDeg = 0; thetaDeg < 360; thetaDeg++) {
+            double thetaRad = thetaDeg * CV_PI / 180.0;
+            rings[r - Rmin][thetaDeg] = Point(cvFloor(-r * cos(thetaRad)), cvFloor(-r * sin(thetaRad)));
+        }
+    return rings;
+}
+
+template<typename T>
+static void drawCircles(const Mat &input, Mat &out, const vector<T> &votes, int houghTH, int Rmin, int Rmax) {
+    input.copyTo(out);
+    size_t plane = (size_t) input.rows * input.cols;
+
+    for (int r = Rmin; r < Rmax; r++) {
+        const T *accR = &votes[(r - Rmin) * plane];
+        for (int b = 0; b < input.rows; b++)
+            for (int a = 0; a < input.cols; a++)
+                if (accR[b * input.cols + a] > houghTH)
+                    circle(out, Point(a, b), r, Scalar(0), 1);
+    }
+}
+
+void hough_circles_parallel(FrameContext &ctx, Mat &out, int houghTH, int Rmin, int Rmax, bool compact,
+                            size_t *accBytes) {
+    EdgeList edges;
+    edgeList(ctx.edges(3, 1, 100, 250), edges);
+    int rows = edges.size.height, cols = edges.size.width;
 
+    vector<vector<Point>> rings = ringOffsets(Rmin, Rmax);
+
+    size_t bytes;
+    if (compact) {
+        vector<ushort> votes;
+        bytes = voteCircles(edges.points, rings, rows, cols, votes);
+        drawCircles(ctx.image(), out, votes, houghTH, Rmin, Rmax);
+    } else {
+        vector<int> votes;
+        bytes = voteCircles(edges.points, rings, rows, cols, votes);
+        drawCircles(ctx.image(), out, votes, houghTH, Rmin, Rmax);
+    }
+
+    if (accBytes)
+        *accBytes = bytes;
+}
+
+void hough_circles_parallel(Mat &input, Mat &out, int houghTH, int Rmin, int Rmax, bool compact,
+                            size_t *accBytes) {
+    FrameContext ctx(input);
+    hough_circles_parallel(ctx, out, houghTH, Rmin, Rmax, compact, accBytes);
+}
+
+Mat hough_circles_parallel(Mat &input, int houghTH, int Rmin, int Rmax, bool compact, size_t *accBytes) {
+    Mat out;
+    hough_circles_parallel(input, out, houghTH, Rmin, Rmax, compact, accBytes);
     return out;
 }
 
-int main() {
-    Mat src = imread("../immagini/monete.png", IMREAD_GRAYSCALE);
+static const int CIRCLE_TILE = 256;
+
+static void circlePeaks(const vector<ushort> &votes, const Rect &box, const Rect &core, int nR, int houghTH, int h,
+                        vector<Vec3i> &peaks) {
+    size_t plane = (size_t) box.area();
+
+    for (int r = 0; r < nR; r++)
+        for (int b = core.y; b < core.y + core.height; b++)
+            for (int a = core.x; a < core.x + core.width; a++) {
+                size_t idx = r * plane + (size_t) (b - box.y) * box.width + (a - box.x);
+                ushort v = votes[idx];
+                if (v <= houghTH)
+                    continue;
+
+                bool isMax = true;
+                for (int dr = max(0, r - h); isMax && dr <= min(nR - 1, r + h); dr++)
+                    for (int db = max(box.y, b - h); isMax && db < min(box.y + box.height, b + h + 1); db++)
+                        for (int da = max(box.x, a - h); isMax && da < min(box.x + box.width, a + h + 1); da++) {
+                            size_t n = dr * plane + (size_t) (db - box.y) * box.width + (da - box.x);
+                            if (votes[n] > v || (votes[n] == v && n < idx))
+                                isMax = false;
+                        }
+
+                if (isMax)
+                    peaks.push_back(Vec3i(a, b, r));
+            }
+}
+
+void hough_circles_detect(const EdgeList &edges, vector<Vec3i> &circles, int houghTH, int Rmin, int Rmax, int spread,
+                          int nmsSize) {
+    int rows = edges.size.height, cols = edges.size.width;
+    vector<vector<Point>> rings = ringOffsets(Rmin, Rmax);
+    int nR = (int) rings.size(), h = nmsSize / 2, reach = max(abs(Rmin), abs(Rmax)) + 1;
+    spread = min(max(spread, 0), 89);
+    circles.clear();
+    if (nR == 0 || rows == 0 || cols == 0)
+        return;
+
+    int tilesX = (cols + CIRCLE_TILE - 1) / CIRCLE_TILE, tilesY = (rows + CIRCLE_TILE - 1) / CIRCLE_TILE;
+    vector<vector<int>> buckets(tilesX * tilesY);
+    for (int e = 0; e < (int) edges.points.size(); e++) {
+        const Point &p = edges.points[e];
+        buckets[p.y / CIRCLE_TILE * tilesX + p.x / CIRCLE_TILE].push_back(e);
+    }
+
+    vector<vector<Vec3i>> tilePeaks(tilesX * tilesY);
+    parallel_for_(Range(0, tilesX * tilesY), [&](const Range &range) {
+        vector<ushort> votes;
+        vector<int> nearby;
+        for (int t = range.start; t < range.end; t++) {
+            Rect core(t % tilesX * CIRCLE_TILE, t / tilesX * CIRCLE_TILE, CIRCLE_TILE, CIRCLE_TILE);
+            core &= Rect(0, 0, cols, rows);
+            Rect box(core.x - h, core.y - h, core.width + 2 * h, core.height + 2 * h);
+            box &= Rect(0, 0, cols, rows);
+
+            nearby.clear();
+            int tx0 = max(0, (box.x - reach) / CIRCLE_TILE);
+            int tx1 = min(tilesX - 1, (box.x + box.width - 1 + reach) / CIRCLE_TILE);
+            int ty0 = max(0, (box.y - reach) / CIRCLE_TILE);
+            int ty1 = min(tilesY - 1, (box.y + box.height - 1 + reach) / CIRCLE_TILE);
+            for (int ty = ty0; ty <= ty1; ty++)
+                for (int tx = tx0; tx <= tx1; tx++)
+                    for (int e: buckets[ty * tilesX + tx]) {
+                        const Point &p = edges.points[e];
+                        if (p.x >= box.x - reach && p.x < box.x + box.width + reach && p.y >= box.y - reach &&
+                            p.y < box.y + box.height + reach)
+                            nearby.push_back(e);
+                    }
+            if (nearby.empty())
+                continue;
+
+            size_t plane = (size_t) box.area();
+            votes.assign(nR * plane, 0);
+            for (int e: nearby)
+                for (int r = 0; r < nR; r++) {
+                    ushort *accR = &votes[r * plane];
+                    auto vote = [&](const Point &d) {
+                        int a = edges.points[e].x + d.x - box.x;
+                        int b = edges.points[e].y + d.y - box.y;
+
+                        if (a >= 0 && a < box.width && b >= 0 && b < box.height)
+                            accR[b * box.width + a]++;
+                    };
+
+                    if (edges.degrees.empty())
+                        for (const Point &d: rings[r])
+                            vote(d);
+                    else
+                        for (int side = 0; side < 360; side += 180)
+                            for (int k = -spread; k <= spread; k++)
+                                vote(rings[r][(edges.degrees[e] + side + k + 360) % 360]);
+                }
+
+            circlePeaks(votes, box, core, nR, houghTH, h, tilePeaks[t]);
+        }
+    });
+
+    for (const vector<Vec3i> &peaks: tilePeaks)
+        circles.insert(circles.end(), peaks.begin(), peaks.end());
+    sort(circles.begin(), circles.end(), [](const Vec3i &p, const Vec3i &q) {
+        return tie(p[2], p[1], p[0]) < tie(q[2], q[1], q[0]);
+    });
+    for (Vec3i &c: circles)
+        c[2] += Rmin;
+}
+
+void hough_circles_gradient(FrameContext &ctx, Mat &out, int houghTH, int Rmin, int Rmax, int spread, int nmsSize) {
+    EdgeList edges;
+    edgeList(ctx.edges(3, 1, 100, 250), edges, ctx.dx(3, 1), ctx.dy(3, 1));
 
-    int houghTH = 175;
-    int Rmin = 20;
-    int Rmax = 70;
+    vector<Vec3i> circles;
+    hough_circles_detect(edges, circles, houghTH, Rmin, Rmax, spread, nmsSize);
 
-    Mat dst = hough_circles(src, houghTH, Rmin, Rmax);
+    ctx.image().copyTo(out);
+    for (const Vec3i &c: circles)
+        circle(out, Point(c[0], c[1]), c[2], Scalar(0), 1);
+}
 
-    imshow("Hough Circles", dst);
-    waitKey(0);
+void hough_circles_gradient(Mat &input, Mat &out, int houghTH, int Rmin, int Rmax, int spread, int nmsSize) {
+    FrameContext ctx(input);
+    hough_circles_gradient(ctx, out, houghTH, Rmin, Rmax, spread, nmsSize);
+}
 
-    return 0;
+Mat hough_circles_gradient(Mat &input, int houghTH, int Rmin, int Rmax, int spread, int nmsSize) {
+    Mat out;
+    hough_circles_gradient(input, out, houghTH, Rmin, Rmax, spread, nmsSize);
+    return out;
 }
@@ -1,15 +1,12 @@
-#include <opencv2/opencv.hpp>
+#include "Algoritmi.h"
 using namespace std;
 using namespace cv;
 
-Mat hough_lines(Mat &input, int houghTH) {
-    Mat img = input.clone();
-
-    GaussianBlur(img, img, Size(5, 5), 0.5, 0.5);
-    Canny(img, img, 50, 150);
+void hough_lines(FrameContext &ctx, Mat &out, int houghTH) {
+    const Mat &img = ctx.edges(5, 0.5, 50, 150);
 
     int diag = cvRound(hypot(img.rows, img.cols));
-    Mat votes = Mat::zeros(diag * 2, 180, CV_8U);
+    Mat votes = Mat::zeros(diag * 2 + 1, 180, CV_32S);
 
     for (int x = 0; x < img.rows; x++)
         for (int y = 0; y < img.cols; y++)
@@ -18,14 +15,14 @@ Mat hough_lines(Mat &input, int houghTH) {
                     double thetaRad = thetaDeg * CV_PI / 180.0;
                     int rho = cvRound(x * sin(thetaRad) + y * cos(thetaRad)) + diag;
 
-                    votes.at<uchar>(rho, thetaDeg)++;
+                    votes.at<int>(rho, thetaDeg)++;
                 }
 
-    Mat out = input.clone();
+    ctx.image().copyTo(out);
     int lineLength = max(img.rows, img.cols);
     for (int rho = 0; rho < votes.rows; rho++)
         for (int thetaDeg = 0; thetaDeg < votes.cols; thetaDeg++)
-            if (votes.at<uchar>(rho, thetaDeg) > houghTH) {
+            if (votes.at<int>(rho, thetaDeg) > houghTH) {
                 double thetaRad = thetaDeg * CV_PI / 180.0;
                 double a = cos(thetaRad), b = sin(thetaRad);
                 double x0 = a * (rho - diag);
@@ -36,17 +33,283 @@ Mat hough_lines(Mat &input, int houghTH) {
 
                 line(out, p1, p2, Scalar(0), 2);
             }
+}
+
+void hough_lines(Mat &input, Mat &out, int houghTH) {
+    FrameContext ctx(input);
+    hough_lines(ctx, out, houghTH);
+}
 
+Mat hough_lines(Mat &input, int houghTH) {
+    Mat out;
+    hough_lines(input, out, houghTH);
     return out;
 }
 
-int main() {
-    Mat src = imread("../immagini/strada.png", IMREAD_GRAYSCALE);
+static void voteLines(const vector<Point> &edges, const vector<float> &sinT, const vector<float> &cosT, int diag,
+                      Mat &votes) {
+    int nTheta = (int) sinT.size();
+    votes = Mat::zeros(diag * 2 + 1, nTheta, CV_32S);
+
+    int nThreads = max(1, getNumThreads());
+    vector<Mat> partial(nThreads);
+    int chunk = ((int) edges.size() + nThreads - 1) / nThreads;
+
+    parallel_for_(Range(0, nThreads), [&](const Range &range) {
+        for (int t = range.start; t < range.end; t++) {
+            partial[t] = Mat::zeros(votes.size(), CV_32S);
+            int *acc = partial[t].ptr<int>();
+
+            int e1 = min((int) edges.size(), (t + 1) * chunk);
+            for (int e = t * chunk; e < e1; e++) {
+                float x = edges[e].y, y = edges[e].x;
+                for (int thetaIdx = 0; thetaIdx < nTheta; thetaIdx++) {
+                    int rho = cvRound(x * sinT[thetaIdx] + y * cosT[thetaIdx]) + diag;
+                    acc[rho * nTheta + thetaIdx]++;
+                }
+            }
+        }
+    }, nThreads);
+
+    parallel_for_(Range(0, votes.rows), [&](const Range &range) {
+        for (int rho = range.start; rho < range.end; rho++) {
+            int *dst = votes.ptr<int>(rho);
+            for (int t = 0; t < nThreads; t++) {
+                const int *src = partial[t].ptr<int>(rho);
+                for (int thetaIdx = 0; thetaIdx < nTheta; thetaIdx++)
+                    dst[thetaIdx] += src[thetaIdx];
+            }
+        }
+    });
+}
+
+static void linePeaks(const Mat &votes, int houghTH, int topN, int diag, double thetaStep, vector<Vec2f> &lines) {
+    vector<pair<int, Vec2f>> peaks;
+
+    for (int rho = 0; rho < votes.rows; rho++)
+        for (int thetaIdx = 0; thetaIdx < votes.cols; thetaIdx++) {
+            int v = votes.at<int>(rho, thetaIdx);
+            if (v <= houghTH)
+                continue;
+
+            bool isMax = true;
+            for (int dr = rho - 1; isMax && dr <= rho + 1; dr++)
+                for (int dt = thetaIdx - 1; isMax && dt <= thetaIdx + 1; dt++) {
+                    int r = dr, t = dt;
+                    if (t < 0 || t >= votes.cols) {
+                        t = (t + votes.cols) % votes.cols;
+                        r = 2 * diag - r;
+                    }
+                    if (r < 0 || r >= votes.rows || (r == rho && t == thetaIdx))
+                        continue;
+
+                    int n = votes.at<int>(r, t);
+                    if (n > v || (n == v && (r < rho || (r == rho && t < thetaIdx))))
+                        isMax = false;
+                }
+
+            if (isMax)
+                peaks.push_back(make_pair(v, Vec2f(rho - diag, thetaIdx * thetaStep)));
+        }
+
+    stable_sort(peaks.begin(), peaks.end(), [](const pair<int, Vec2f> &a, const pair<int, Vec2f> &b) {
+        return a.first > b.first;
+    });
+    if (topN > 0 && (int) peaks.size() > topN)
+        peaks.resize(topN);
+
+    lines.clear();
+    for (const auto &p: peaks)
+        lines.push_back(p.second);
+}
+
+void hough_lines_detect(const EdgeList &edges, vector<Vec2f> &lines, int houghTH, int topN, int nTheta) {
+    double thetaStep = CV_PI / nTheta;
+    vector<float> sinT(nTheta), cosT(nTheta);
+    for (int thetaIdx = 0; thetaIdx < nTheta; thetaIdx++) {
+        sinT[thetaIdx] = (float) sin(thetaIdx * thetaStep);
+        cosT[thetaIdx] = (float) cos(thetaIdx * thetaStep);
+    }
+
+    int diag = cvRound(hypot(edges.size.height, edges.size.width));
+    Mat votes;
+    voteLines(edges.points, sinT, cosT, diag, votes);
+
+    linePeaks(votes, houghTH, topN, diag, thetaStep, lines);
+}
+
+void hough_lines_detect(FrameContext &ctx, vector<Vec2f> &lines, int houghTH, int topN, int nTheta) {
+    EdgeList edges;
+    edgeList(ctx.edges(5, 0.5, 50, 150), edges);
+    hough_lines_detect(edges, lines, houghTH, topN, nTheta);
+}
+
+void hough_lines_detect(Mat &input, vector<Vec2f> &lines, int houghTH, int topN, int nTheta) {
+    FrameContext ctx(input);
+    hough_lines_detect(ctx, lines, houghTH, topN, nTheta);
+}
+
+vector<Vec2f> hough_lines_detect(Mat &input, int houghTH, int topN, int nTheta) {
+    vector<Vec2f> lines;
+    hough_lines_detect(input, lines, houghTH, topN, nTheta);
+    return lines;
+}
+
+void hough_lines_parallel(FrameContext &ctx, Mat &out, int houghTH, int topN, int nTheta) {
+    vector<Vec2f> lines;
+    hough_lines_detect(ctx, lines, houghTH, topN, nTheta);
 
-    int houghTH = 150;
-    Mat dst = hough_lines(src, houghTH);
+    const Mat &input = ctx.image();
+    input.copyTo(out);
+    int lineLength = max(input.rows, input.cols);
+    for (const Vec2f &l: lines) {
+        double a = cos(l[1]), b = sin(l[1]);
+        double x0 = a * l[0];
+        double y0 = b * l[0];
 
-    imshow("HoughLines", dst);
-    waitKey(0);
-    return 0;
+        Point p1(cvRound(x0 - lineLength * b), cvRound(y0 + lineLength * a));
+        Point p2(cvRound(x0 + lineLength * b), cvRound(y0 - lineLength * a));
+
+        line(out, p1, p2, Scalar(0), 2);
+    }
+}
+
+void hough_lines_parallel(Mat &input, Mat &out, int houghTH, int topN, int nTheta) {
+    FrameContext ctx(input);
+    hough_lines_parallel(ctx, out, houghTH, topN, nTheta);
+}
+
+Mat hough_lines_parallel(Mat &input, int houghTH, int topN, int nTheta) {
+    Mat out;
+    hough_lines_parallel(input, out, houghTH, topN, nTheta);
+    return out;
+}
+
+void hough_lines_probabilistic(const EdgeList &edges, vector<Vec4i> &segments, int houghTH, int minLength, int maxGap,
+                               int nTheta) {
+    vector<Point> order = edges.points;
+    RNG rng;
+    for (int i = (int) order.size() - 1; i > 0; i--)
+        swap(order[i], order[rng.uniform(0, i + 1)]);
+
+    double thetaStep = CV_PI / nTheta;
+    vector<float> sinT(nTheta), cosT(nTheta);
+    for (int thetaIdx = 0; thetaIdx < nTheta; thetaIdx++) {
+        sinT[thetaIdx] = (float) sin(thetaIdx * thetaStep);
+        cosT[thetaIdx] = (float) cos(thetaIdx * thetaStep);
+    }
+
+    int diag = cvRound(hypot(edges.size.height, edges.size.width));
+    Mat votes = Mat::zeros(diag * 2 + 1, nTheta, CV_32S);
+    int *acc = votes.ptr<int>();
+
+    const uchar EDGE = 255, VOTED = 128;
+    Mat mask = Mat::zeros(edges.size, CV_8U);
+    for (const Point &p: edges.points)
+        mask.at<uchar>(p) = EDGE;
+
+    auto vote = [&](Point p, int delta) {
+        for (int thetaIdx = 0; thetaIdx < nTheta; thetaIdx++) {
+            int rho = cvRound(p.x * cosT[thetaIdx] + p.y * sinT[thetaIdx]) + diag;
+            acc[rho * nTheta + thetaIdx] += delta;
+        }
+    };
+
+    segments.clear();
+    for (const Point &p: order) {
+        if (mask.at<uchar>(p) != EDGE)
+            continue;
+
+        int best = houghTH, bestIdx = -1;
+        for (int thetaIdx = 0; thetaIdx < nTheta; thetaIdx++) {
+            int rho = cvRound(p.x * cosT[thetaIdx] + p.y * sinT[thetaIdx]) + diag;
+            int v = ++acc[rho * nTheta + thetaIdx];
+            if (v > best) {
+                best = v;
+                bestIdx = thetaIdx;
+            }
+        }
+        mask.at<uchar>(p) = VOTED;
+
+        if (bestIdx < 0)
+            continue;
+
+        float dx = -sinT[bestIdx], dy = cosT[bestIdx];
+        float step = max(fabs(dx), fabs(dy));
+        dx /= step;
+        dy /= step;
+
+        Point ends[2] = {p, p};
+        for (int k = 0; k < 2; k++) {
+            float sign = k ? -1.f : 1.f, x = p.x, y = p.y;
+            for (int gap = 0; gap <= maxGap;) {
+                x += sign * dx;
+                y += sign * dy;
+                Point q(cvRound(x), cvRound(y));
+                if (q.x < 0 || q.x >= mask.cols || q.y < 0 || q.y >= mask.rows)
+                    break;
+
+                if (mask.at<uchar>(q)) {
+                    ends[k] = q;
+                    gap = 0;
+                } else
+                    gap++;
+            }
+        }
+
+        bool goodLine = max(abs(ends[0].x - ends[1].x), abs(ends[0].y - ends[1].y)) >= minLength;
+
+        auto release = [&](Point q) {
+            uchar &m = mask.at<uchar>(q);
+            if (goodLine && m == VOTED)
+                vote(q, -1);
+            m = 0;
+        };
+
+        release(p);
+        for (int k = 0; k < 2; k++) {
+            float sign = k ? -1.f : 1.f, x = p.x, y = p.y;
+            for (Point q = p; q != ends[k];) {
+                x += sign * dx;
+                y += sign * dy;
+                q = Point(cvRound(x), cvRound(y));
+                release(q);
+            }
+        }
+
+        if (goodLine)
+            segments.push_back(Vec4i(ends[0].x, ends[0].y, ends[1].x, ends[1].y));
+    }
+}
+
+void hough_lines_probabilistic(FrameContext &ctx, vector<Vec4i> &segments, int houghTH, int minLength, int maxGap,
+                               int nTheta) {
+    EdgeList edges;
+    edgeList(ctx.edges(5, 0.5, 50, 150), edges);
+    hough_lines_probabilistic(edges, segments, houghTH, minLength, maxGap, nTheta);
+}
+
+void hough_lines_probabilistic(Mat &input, vector<Vec4i> &segments, int houghTH, int minLength, int maxGap,
+                               int nTheta) {
+    FrameContext ctx(input);
+    hough_lines_probabilistic(ctx, segments, houghTH, minLength, maxGap, nTheta);
+}
+
+vector<Vec4i> hough_lines_probabilistic(Mat &input, int houghTH, int minLength, int maxGap, int nTheta) {
+    vector<Vec4i> segments;
+    hough_lines_probabilistic(input, segments, houghTH, minLength, maxGap, nTheta);
+    return segments;
+}
+
+int hough_lines_recall(const vector<Vec2f> &lines, const vector<Vec4i> &segments, double tol) {
+    int recalled = 0;
+    for (const Vec2f &l: lines) {
+        double c = cos(l[1]), sn = sin(l[1]);
+        for (const Vec4i &s: segments)
+            if (fabs(s[0] * c + s[1] * sn - l[0]) <= tol && fabs(s[2] * c + s[3] * sn - l[0]) <= tol) {
+                recalled++;
+                break;
+            }
+    }
+    return recalled;
 }
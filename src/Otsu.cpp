@@ -1,8 +1,8 @@
-#include <opencv2/opencv.hpp>
+#include "Algoritmi.h"
 using namespace std;
 using namespace cv;
 
-Mat otsu(Mat &input) {
+void otsu(Mat &input, Mat &out) {
     Mat img = input.clone();
     GaussianBlur(img, img, Size(3, 3), 0.5, 0.5);
 
@@ -36,18 +36,11 @@ Mat otsu(Mat &input) {
         }
     }
 
-    Mat out;
     threshold(img, out, bestTH, 255, THRESH_BINARY);
-    return out;
 }
 
-int main() {
-    Mat src = imread("../immagini/fiore.png", IMREAD_GRAYSCALE);
-
-    Mat dst = otsu(src);
-
-    imshow("Otsu", dst);
-    waitKey(0);
-
-    return 0;
+Mat otsu(Mat &input) {
+    Mat out;
+    otsu(input, out);
+    return out;
 }
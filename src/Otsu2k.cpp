@@ -1,8 +1,8 @@
-#include <opencv2/opencv.hpp>
+#include "Algoritmi.h"
 using namespace std;
 using namespace cv;
 
-Mat otsu2k(Mat &input) {
+void otsu2k(Mat &input, Mat &out) {
     Mat img = input.clone();
     GaussianBlur(img, img, Size(3, 3), 0.5, 0.5);
 
@@ -53,7 +53,7 @@ Mat otsu2k(Mat &input) {
             }
         }
 
-    Mat out = img.clone();
+    img.copyTo(out);
     for (int x = 0; x < out.rows; x++)
         for (int y = 0; y < out.cols; y++) {
             uchar val = out.at<uchar>(x, y);
@@ -64,17 +64,81 @@ Mat otsu2k(Mat &input) {
             else
                 out.at<uchar>(x, y) = 255;
         }
+}
 
+Mat otsu2k(Mat &input) {
+    Mat out;
+    otsu2k(input, out);
     return out;
 }
 
-int main() {
-    Mat src = imread("../immagini/fiore.png", IMREAD_GRAYSCALE);
+void otsuMulti(Mat &input, Mat &out, int K, vector<int> &thresholds) {
+    CV_Assert(K >= 1 && K <= 255);
+    Mat img = input.clone();
+    GaussianBlur(img, img, Size(3, 3), 0.5, 0.5);
+
+    vector<double> hist(256, 0.0);
+    for (int x = 0; x < img.rows; x++) {
+        const uchar *row = img.ptr<uchar>(x);
+        for (int y = 0; y < img.cols; y++)
+            hist[row[y]]++;
+    }
+
+    vector<double> P(257, 0.0), S(257, 0.0);
+    for (int i = 0; i < 256; i++) {
+        P[i + 1] = P[i] + hist[i];
+        S[i + 1] = S[i] + i * hist[i];
+    }
+
+    const double invalid = -1.0;
+    auto classVar = [&](int a, int b) {
+        double w = P[b + 1] - P[a];
+        if (w <= 0)
+            return invalid;
+        double s = S[b + 1] - S[a];
+        return s * s / w;
+    };
 
-    Mat dst = otsu2k(src);
+    vector<vector<double>> D(K + 1, vector<double>(256, invalid));
+    vector<vector<int>> from(K + 1, vector<int>(256, -1));
+    for (int t = 0; t < 256; t++)
+        D[0][t] = classVar(0, t);
 
-    imshow("Otsu2k", dst);
-    waitKey(0);
+    for (int c = 1; c <= K; c++)
+        for (int t = c; t < 256; t++)
+            for (int s = c - 1; s < t; s++) {
+                double h = classVar(s + 1, t);
+                if (D[c - 1][s] < 0 || h < 0)
+                    continue;
 
-    return 0;
+                double var = D[c - 1][s] + h;
+                if (var > D[c][t]) {
+                    D[c][t] = var;
+                    from[c][t] = s;
+                }
+            }
+
+    while (K > 0 && from[K][255] < 0)
+        K--;
+
+    thresholds.assign(K, 0);
+    for (int c = K, t = 255; c > 0; c--) {
+        t = from[c][t];
+        thresholds[c - 1] = t;
+    }
+
+    Mat lut(1, 256, CV_8U);
+    for (int v = 0, c = 0; v < 256; v++) {
+        while (c < K && v > thresholds[c])
+            c++;
+        lut.at<uchar>(0, v) = K > 0 ? c * 255 / K : 0;
+    }
+
+    LUT(img, lut, out);
+}
+
+Mat otsuMulti(Mat &input, int K, vector<int> &thresholds) {
+    Mat out;
+    otsuMulti(input, out, K, thresholds);
+    return out;
 }
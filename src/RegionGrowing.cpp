@@ -1,9 +1,11 @@
-#include <opencv2/opencv.hpp>
+#include "Algoritmi.h"
 #include <stack>
+#include <climits>
+#include <atomic>
 using namespace cv;
 using namespace std;
 
-Mat regionGrowing(Mat &input) {
+void regionGrowing(Mat &input, Mat &labels) {
     Mat img = input.clone();
 
     int simTH = 5;
@@ -11,7 +13,8 @@ Mat regionGrowing(Mat &input) {
     uchar maxLabels = 100;
 
     int minArea = int(minAreaFactor * img.rows * img.cols);
-    Mat labels = Mat::zeros(img.rows, img.cols, CV_8U);
+    labels.create(img.rows, img.cols, CV_8U);
+    labels.setTo(0);
     Mat regionMask = Mat::zeros(img.rows, img.cols, CV_8U);
     uchar currentLabel = 1;
 
@@ -58,21 +61,266 @@ Mat regionGrowing(Mat &input) {
             if (regionArea > minArea) {
                 labels += regionMask * currentLabel;
                 if (currentLabel++ > maxLabels)
-                    return labels;
+                    return;
             } else
                 labels += regionMask * 255;
         }
+}
 
+Mat regionGrowing(Mat &input) {
+    Mat labels;
+    regionGrowing(input, labels);
     return labels;
 }
 
-int main() {
-    Mat src = imread("../immagini/splash.png", IMREAD_GRAYSCALE);
+void regionGrowingScan(Mat &input, Mat &labels, vector<Rect> *boxes, Workspace *ws) {
+    int simTH = 5;
+    double minAreaFactor = 0.01;
+
+    int rows = input.rows, cols = input.cols;
+    int minArea = int(minAreaFactor * rows * cols);
+    const int REGION = INT_MAX, SMALL = -1;
+
+    labels.create(rows, cols, CV_32S);
+    labels.setTo(0);
+    int currentLabel = 1;
+    Workspace local;
+    vector<Vec3i> &spans = (ws ? *ws : local).vec<Vec3i>("regionGrowingScan.spans", 0);
+    if (boxes)
+        boxes->clear();
+
+    auto pushSpan = [&](int x, int y) {
+        const uchar *row = input.ptr<uchar>(x);
+        int *lab = labels.ptr<int>(x);
+        int yl = y, yr = y;
+
+        lab[y] = REGION;
+        while (yl > 0 && lab[yl - 1] == 0 && abs(row[yl] - row[yl - 1]) < simTH)
+            lab[--yl] = REGION;
+        while (yr < cols - 1 && lab[yr + 1] == 0 && abs(row[yr] - row[yr + 1]) < simTH)
+            lab[++yr] = REGION;
+
+        spans.push_back(Vec3i(x, yl, yr));
+        return yr;
+    };
+
+    for (int x = 0; x < rows; x++)
+        for (int y = 0; y < cols; y++) {
+            if (labels.ptr<int>(x)[y] != 0)
+                continue;
+
+            spans.clear();
+            pushSpan(x, y);
+
+            int regionArea = 0;
+            for (size_t s = 0; s < spans.size(); s++) {
+                Vec3i span = spans[s];
+                regionArea += span[2] - span[1] + 1;
+                const uchar *row = input.ptr<uchar>(span[0]);
+
+                for (int nx = span[0] - 1; nx <= span[0] + 1; nx += 2) {
+                    if (nx < 0 || nx >= rows)
+                        continue;
+
+                    const uchar *nrow = input.ptr<uchar>(nx);
+                    const int *nlab = labels.ptr<int>(nx);
+                    for (int ny = max(0, span[1] - 1); ny <= min(cols - 1, span[2] + 1); ny++) {
+                        if (nlab[ny] != 0)
+                            continue;
+
+                        bool joins = false;
+                        for (int py = max(span[1], ny - 1); !joins && py <= min(span[2], ny + 1); py++)
+                            joins = abs(int(row[py]) - int(nrow[ny])) < simTH;
+
+                        if (joins)
+                            ny = pushSpan(nx, ny);
+                    }
+                }
+            }
+
+            int label = regionArea > minArea ? currentLabel++ : SMALL;
+            int top = rows, bottom = -1, left = cols, right = -1;
+            for (const Vec3i &span: spans) {
+                int *lab = labels.ptr<int>(span[0]);
+                fill(lab + span[1], lab + span[2] + 1, label);
+
+                top = min(top, span[0]);
+                bottom = max(bottom, span[0]);
+                left = min(left, span[1]);
+                right = max(right, span[2]);
+            }
+
+            if (boxes && label != SMALL)
+                boxes->push_back(Rect(left, top, right - left + 1, bottom - top + 1));
+        }
+}
+
+Mat regionGrowingScan(Mat &input, vector<Rect> *boxes) {
+    Mat labels;
+    regionGrowingScan(input, labels, boxes);
+    return labels;
+}
+
+static int findRoot(vector<atomic<int>> &parent, int i) {
+    while (true) {
+        int p = parent[i].load();
+        if (p == i)
+            return i;
+
+        int gp = parent[p].load();
+        if (gp != p)
+            parent[i].compare_exchange_weak(p, gp);
+        i = gp;
+    }
+}
+
+static void unite(vector<atomic<int>> &parent, int a, int b) {
+    while (true) {
+        a = findRoot(parent, a);
+        b = findRoot(parent, b);
+        if (a == b)
+            return;
+
+        if (a < b)
+            swap(a, b);
+        int expected = a;
+        if (parent[a].compare_exchange_strong(expected, b))
+            return;
+    }
+}
+
+void regionGrowingParallel(Mat &input, Mat &labels, vector<Rect> *boxes) {
+    int simTH = 5;
+    double minAreaFactor = 0.01;
+
+    int rows = input.rows, cols = input.cols;
+    int minArea = int(minAreaFactor * rows * cols);
+
+    labels.create(rows, cols, CV_32S);
+    vector<atomic<int>> parent((size_t) rows * cols);
+
+    int bandRows = max(8, rows / (4 * max(1, getNumThreads())));
+    int nBands = (rows + bandRows - 1) / bandRows;
 
-    Mat dst = regionGrowing(src);
+    auto similar = [&](const uchar *a, int ia, const uchar *b, int ib) { return abs(a[ia] - b[ib]) < simTH; };
+    auto linkRow = [&](int x, bool withUpper) {
+        const uchar *row = input.ptr<uchar>(x);
+        const uchar *up = x > 0 ? input.ptr<uchar>(x - 1) : nullptr;
+        int base = x * cols;
 
-    imshow("RegionGrowing", dst);
-    waitKey(0);
+        for (int y = 0; y < cols; y++) {
+            if (!withUpper) {
+                if (y > 0 && similar(row, y, row, y - 1))
+                    unite(parent, base + y, base + y - 1);
+                continue;
+            }
+            for (int ny = max(0, y - 1); ny <= min(cols - 1, y + 1); ny++)
+                if (similar(row, y, up, ny))
+                    unite(parent, base + y, base - cols + ny);
+        }
+    };
+
+    parallel_for_(Range(0, nBands), [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++)
+            for (int x = b * bandRows; x < min(rows, (b + 1) * bandRows); x++) {
+                for (int y = 0; y < cols; y++)
+                    parent[x * cols + y].store(x * cols + y);
 
-    return 0;
+                linkRow(x, false);
+                if (x > b * bandRows)
+                    linkRow(x, true);
+            }
+    });
+
+    parallel_for_(Range(1, nBands), [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++)
+            linkRow(b * bandRows, true);
+    });
+
+    parallel_for_(Range(0, nBands), [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++)
+            for (int x = b * bandRows; x < min(rows, (b + 1) * bandRows); x++) {
+                int *lab = labels.ptr<int>(x);
+                for (int y = 0; y < cols; y++)
+                    lab[y] = findRoot(parent, x * cols + y);
+            }
+    });
+
+    parallel_for_(Range(0, nBands), [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++)
+            for (int i = b * bandRows * cols; i < min(rows, (b + 1) * bandRows) * cols; i++)
+                parent[i].store(0);
+    });
+
+    parallel_for_(Range(0, nBands), [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++) {
+            const int *lab = labels.ptr<int>(b * bandRows);
+            int n = (min(rows, (b + 1) * bandRows) - b * bandRows) * cols;
+            for (int i = 0; i < n;) {
+                int j = i;
+                while (j < n && lab[j] == lab[i])
+                    j++;
+                parent[lab[i]].fetch_add(j - i);
+                i = j;
+            }
+        }
+    });
+
+    vector<int> firstLabel(nBands + 1, 0);
+    parallel_for_(Range(0, nBands), [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++)
+            for (int i = b * bandRows * cols; i < min(rows, (b + 1) * bandRows) * cols; i++)
+                if (labels.ptr<int>()[i] == i && parent[i].load() > minArea)
+                    firstLabel[b + 1]++;
+    });
+    for (int b = 0; b < nBands; b++)
+        firstLabel[b + 1] += firstLabel[b];
+
+    parallel_for_(Range(0, nBands), [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++) {
+            int currentLabel = firstLabel[b] + 1;
+            for (int i = b * bandRows * cols; i < min(rows, (b + 1) * bandRows) * cols; i++)
+                if (labels.ptr<int>()[i] == i)
+                    parent[i].store(parent[i].load() > minArea ? currentLabel++ : -1);
+        }
+    });
+
+    int nLabels = firstLabel[nBands];
+    vector<vector<Vec4i>> bandBoxes(nBands, vector<Vec4i>(nLabels, Vec4i(cols, rows, -1, -1)));
+    parallel_for_(Range(0, nBands), [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++)
+            for (int x = b * bandRows; x < min(rows, (b + 1) * bandRows); x++) {
+                int *lab = labels.ptr<int>(x);
+                for (int y = 0; y < cols; y++) {
+                    lab[y] = parent[lab[y]].load();
+                    if (lab[y] > 0) {
+                        Vec4i &box = bandBoxes[b][lab[y] - 1];
+                        box[0] = min(box[0], y);
+                        box[1] = min(box[1], x);
+                        box[2] = max(box[2], y);
+                        box[3] = max(box[3], x);
+                    }
+                }
+            }
+    });
+
+    if (boxes) {
+        boxes->assign(nLabels, Rect());
+        for (int l = 0; l < nLabels; l++) {
+            Vec4i box(cols, rows, -1, -1);
+            for (int b = 0; b < nBands; b++) {
+                box[0] = min(box[0], bandBoxes[b][l][0]);
+                box[1] = min(box[1], bandBoxes[b][l][1]);
+                box[2] = max(box[2], bandBoxes[b][l][2]);
+                box[3] = max(box[3], bandBoxes[b][l][3]);
+            }
+            (*boxes)[l] = Rect(box[0], box[1], box[2] - box[0] + 1, box[3] - box[1] + 1);
+        }
+    }
+}
+
+Mat regionGrowingParallel(Mat &input, vector<Rect> *boxes) {
+    Mat labels;
+    regionGrowingParallel(input, labels, boxes);
+    return labels;
 }
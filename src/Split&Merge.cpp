@@ -1,4 +1,5 @@
-#include <opencv2/opencv.hpp>
+#include "Algoritmi.h"
+#include <queue>
 
 using namespace cv;
 using namespace std;
@@ -6,107 +7,290 @@ using namespace std;
 double smTH = 10;
 int tSize = 8;
 int mTH = 5;
+int parallelDepth = 2;
 
-class TNode {
-public:
-    Rect region;
-    TNode *regions[4] = {nullptr};
-    vector<TNode *> merged;
-    bool isMerged[4] = {false};
-    double stddev, mean;
+static bool splittable(const TNode &node) {
+    return min(node.region.width, node.region.height) > tSize && node.stddev > smTH;
+}
+
+static double rectSum(const Mat &S, Rect R) {
+    return S.at<double>(R.y + R.height, R.x + R.width) - S.at<double>(R.y, R.x + R.width) -
+           S.at<double>(R.y + R.height, R.x) + S.at<double>(R.y, R.x);
+}
+
+static TNode makeNode(const QuadTree &tree, Rect R) {
+    TNode node(R);
+    double n = R.area();
+    node.mean = rectSum(tree.sum, R) / n;
+    node.stddev = sqrt(max(0.0, rectSum(tree.sqsum, R) / n - node.mean * node.mean));
+    return node;
+}
+
+static void quadrants(Rect R, Rect quads[4]) {
+    int h = R.height / 2, w = R.width / 2;
+    quads[0] = Rect(R.x, R.y, w, h);
+    quads[1] = Rect(R.x, R.y + h, w, R.height - h);
+    quads[2] = Rect(R.x + w, R.y, R.width - w, h);
+    quads[3] = Rect(R.x + w, R.y + h, R.width - w, R.height - h);
+}
+
+static int splitSerial(const QuadTree &tree, vector<TNode> &nodes, Rect R) {
+    int root = (int) nodes.size();
+    nodes.push_back(makeNode(tree, R));
+
+    if (splittable(nodes[root])) {
+        Rect quads[4];
+        quadrants(R, quads);
+
+        int children[4];
+        for (int i = 0; i < 4; i++)
+            children[i] = splitSerial(tree, nodes, quads[i]);
+        copy(children, children + 4, nodes[root].regions);
+    }
+
+    return root;
+}
 
-    TNode(Rect R) : region(R) {}
+struct SplitTask {
+    int parent, slot;
+    Rect region;
 };
 
-TNode *split(Mat &img, Rect R) {
-    TNode *root = new TNode(R);
+static int splitTop(QuadTree &tree, Rect R, int depth, vector<SplitTask> &tasks) {
+    int root = (int) tree.nodes.size();
+    tree.nodes.push_back(makeNode(tree, R));
 
-    Scalar stddev, mean;
-    meanStdDev(img(R), mean, stddev);
-    root->mean = mean[0];
-    root->stddev = stddev[0];
+    if (splittable(tree.nodes[root])) {
+        Rect quads[4];
+        quadrants(R, quads);
 
-    if (R.width > tSize && root->stddev > smTH) {
-        int h = R.height / 2, w = R.width / 2;
-        root->regions[0] = split(img, Rect(R.x, R.y, h, w));
-        root->regions[1] = split(img, Rect(R.x, R.y + w, h, w));
-        root->regions[2] = split(img, Rect(R.x + h, R.y, h, w));
-        root->regions[3] = split(img, Rect(R.x + h, R.y + w, h, w));
+        for (int i = 0; i < 4; i++)
+            if (depth + 1 < parallelDepth) {
+                int child = splitTop(tree, quads[i], depth + 1, tasks);
+                tree.nodes[root].regions[i] = child;
+            } else
+                tasks.push_back({root, i, quads[i]});
     }
 
-    rectangle(img, R, Scalar(0));
     return root;
 }
 
-void merge(TNode *root) {
-    if (root->region.width > tSize && root->stddev > smTH) {
+int split(QuadTree &tree, Rect R) {
+    if (parallelDepth <= 0)
+        return splitSerial(tree, tree.nodes, R);
+
+    vector<SplitTask> tasks;
+    int root = splitTop(tree, R, 0, tasks);
+
+    if (tree.taskNodes.size() < tasks.size())
+        tree.taskNodes.resize(tasks.size());
+
+    parallel_for_(Range(0, (int) tasks.size()), [&](const Range &range) {
+        for (int t = range.start; t < range.end; t++) {
+            tree.taskNodes[t].clear();
+            splitSerial(tree, tree.taskNodes[t], tasks[t].region);
+        }
+    }, (double) tasks.size());
+
+    for (size_t t = 0; t < tasks.size(); t++) {
+        int base = (int) tree.nodes.size();
+        for (TNode node: tree.taskNodes[t]) {
+            for (int i = 0; i < 4; i++)
+                if (node.regions[i] >= 0)
+                    node.regions[i] += base;
+            tree.nodes.push_back(node);
+        }
+        tree.nodes[tasks[t].parent].regions[tasks[t].slot] = base;
+    }
+
+    return root;
+}
+
+void drawQuadTree(const QuadTree &tree, Mat &img) {
+    for (const TNode &node: tree.nodes)
+        rectangle(img, node.region, Scalar(0));
+}
+
+void merge(QuadTree &tree, int r) {
+    TNode &root = tree.nodes[r];
+    root.mergedStart = (int) tree.merged.size();
+
+    if (splittable(root)) {
         int mean[4];
         for (int i = 0; i < 4; i++)
-            mean[i] = (int) root->regions[i]->mean;
+            mean[i] = (int) tree.nodes[root.regions[i]].mean;
 
         for (int i = 0; i < 4; i++) {
             int next = (i + 1) % 4;
             if (abs(mean[i] - mean[next]) < mTH) {
-                root->merged.push_back(root->regions[i]);
-                root->merged.push_back(root->regions[next]);
-                root->isMerged[i] = root->isMerged[next] = true;
+                tree.merged.push_back(root.regions[i]);
+                tree.merged.push_back(root.regions[next]);
+                root.isMerged[i] = root.isMerged[next] = true;
 
                 int next2 = (i + 2) % 4, prev = (i + 3) % 4;
                 if (abs(mean[next] - mean[next2]) < mTH) {
-                    root->merged.push_back(root->regions[next2]);
-                    root->isMerged[next2] = true;
+                    tree.merged.push_back(root.regions[next2]);
+                    root.isMerged[next2] = true;
                 } else if (abs(mean[prev] - mean[i]) < mTH) {
-                    root->merged.push_back(root->regions[prev]);
-                    root->isMerged[prev] = true;
+                    tree.merged.push_back(root.regions[prev]);
+                    root.isMerged[prev] = true;
                 }
             }
         }
+        root.mergedCount = (int) tree.merged.size() - root.mergedStart;
+
         for (int i = 0; i < 4; i++)
-            if (!root->isMerged[i])
-                merge(root->regions[i]);
-    } else
-        root->merged.push_back(root);
+            if (!root.isMerged[i])
+                merge(tree, root.regions[i]);
+    } else {
+        tree.merged.push_back(r);
+        root.mergedCount = 1;
+    }
 }
 
-void segment(TNode *root, Mat &img) {
+void segment(QuadTree &tree, int r, Mat &img) {
+    const TNode &root = tree.nodes[r];
+    const int *merged = tree.merged.data() + root.mergedStart;
+
     float val = 0;
-    for (auto node: root->merged)
-        val += node->mean;
-    val /= root->merged.size();
+    for (int i = 0; i < root.mergedCount; i++)
+        val += tree.nodes[merged[i]].mean;
+    val /= root.mergedCount;
 
-    for (auto node: root->merged)
-        img(node->region) = (int) val;
+    for (int i = 0; i < root.mergedCount; i++)
+        img(tree.nodes[merged[i]].region) = (int) val;
 
     for (int i = 0; i < 4; i++)
-        if (!root->isMerged[i] && root->regions[i])
-            segment(root->regions[i], img);
+        if (!root.isMerged[i] && root.regions[i] >= 0)
+            segment(tree, root.regions[i], img);
+}
+
+static int findRegion(vector<int> &parent, int i) {
+    while (parent[i] != i)
+        i = parent[i] = parent[parent[i]];
+    return i;
 }
 
-void SplitMerge(Mat &input) {
-    Mat img = input.clone();
-    GaussianBlur(img, img, Size(3, 3), 1, 1);
+int mergeRegions(QuadTree &tree, Mat &img) {
+    vector<int> leaves;
+    for (int i = 0; i < (int) tree.nodes.size(); i++)
+        if (tree.nodes[i].regions[0] < 0)
+            leaves.push_back(i);
+
+    int n = (int) leaves.size();
+    tree.leafIds.create(img.size(), CV_32S);
+    for (int l = 0; l < n; l++)
+        tree.leafIds(tree.nodes[leaves[l]].region).setTo(l);
 
-    int exponent = log(min(img.cols, img.rows)) / log(2);
-    int quadSize = pow(2.0, (double) exponent);
+    vector<int> parent(n), mark(n, -1);
+    vector<double> sum(n), area(n);
+    vector<vector<int>> adj(n);
 
-    Rect square = Rect(0, 0, quadSize, quadSize);
-    img = img(square).clone();
+    for (int l = 0; l < n; l++) {
+        const TNode &leaf = tree.nodes[leaves[l]];
+        Rect R = leaf.region;
+        parent[l] = l;
+        area[l] = R.area();
+        sum[l] = leaf.mean * area[l];
+
+        int prev = -1;
+        for (int y = R.y; R.x + R.width < img.cols && y < R.y + R.height; y++) {
+            int m = tree.leafIds.at<int>(y, R.x + R.width);
+            if (m != prev) {
+                adj[l].push_back(m);
+                adj[m].push_back(l);
+                prev = m;
+            }
+        }
+
+        prev = -1;
+        for (int x = R.x; R.y + R.height < img.rows && x < R.x + R.width; x++) {
+            int m = tree.leafIds.at<int>(R.y + R.height, x);
+            if (m != prev) {
+                adj[l].push_back(m);
+                adj[m].push_back(l);
+                prev = m;
+            }
+        }
+    }
 
-    Mat imgSeg = img.clone();
+    auto meanOf = [&](int r) { return sum[r] / area[r]; };
 
-    TNode *root = split(img, Rect(0, 0, img.rows, img.cols));
-    merge(root);
-    segment(root, imgSeg);
+    typedef pair<double, pair<int, int>> Edge;
+    priority_queue<Edge, vector<Edge>, greater<Edge>> edges;
+    for (int a = 0; a < n; a++)
+        for (int b: adj[a])
+            if (a < b)
+                edges.push(Edge(fabs(meanOf(a) - meanOf(b)), make_pair(a, b)));
 
-    imshow("Quad Tree", img);
-    imshow("Segmented", imgSeg);
-    waitKey(0);
+    int regions = n;
+    for (int stamp = 0; !edges.empty(); stamp++) {
+        Edge e = edges.top();
+        edges.pop();
+
+        int a = findRegion(parent, e.second.first), b = findRegion(parent, e.second.second);
+        if (a == b)
+            continue;
+
+        double diff = fabs(meanOf(a) - meanOf(b));
+        if (diff != e.first)
+            continue;
+        if (diff >= mTH)
+            break;
+
+        if (adj[a].size() < adj[b].size())
+            swap(a, b);
+        parent[b] = a;
+        sum[a] += sum[b];
+        area[a] += area[b];
+        regions--;
+
+        adj[a].insert(adj[a].end(), adj[b].begin(), adj[b].end());
+        vector<int>().swap(adj[b]);
+
+        mark[a] = stamp;
+        int kept = 0;
+        for (int m: adj[a]) {
+            m = findRegion(parent, m);
+            if (mark[m] != stamp) {
+                mark[m] = stamp;
+                adj[a][kept++] = m;
+                edges.push(Edge(fabs(meanOf(a) - meanOf(m)), make_pair(a, m)));
+            }
+        }
+        adj[a].resize(kept);
+    }
+
+    for (int l = 0; l < n; l++)
+        img(tree.nodes[leaves[l]].region) = (int) meanOf(findRegion(parent, l));
+
+    return regions;
 }
 
-int main() {
-    Mat src = imread("../immagini/foglia.png", IMREAD_GRAYSCALE);
+int SplitMerge(Mat &input, QuadTree &tree, Mat &imgQuad, Mat &imgSeg, Mat &imgRAG) {
+    input.copyTo(imgQuad);
+    GaussianBlur(imgQuad, imgQuad, Size(3, 3), 1, 1);
+
+    imgQuad.copyTo(imgSeg);
+    imgQuad.copyTo(imgRAG);
 
-    SplitMerge(src);
+    tree.reset();
+    integral(imgQuad, tree.sum, tree.sqsum, CV_64F, CV_64F);
+    int root = split(tree, Rect(0, 0, imgQuad.cols, imgQuad.rows));
+    drawQuadTree(tree, imgQuad);
+    merge(tree, root);
+    segment(tree, root, imgSeg);
+    return mergeRegions(tree, imgRAG);
+}
+
+void SplitMergeSegment(Mat &input, Mat &out) {
+    static thread_local QuadTree tree;
+    static thread_local Mat imgQuad, imgSeg;
+    SplitMerge(input, tree, imgQuad, imgSeg, out);
+}
 
-    return 0;
+Mat SplitMergeSegment(Mat &input) {
+    Mat out;
+    SplitMergeSegment(input, out);
+    return out;
 }
@@ -1,8 +1,15 @@
-#include <opencv2/opencv.hpp>
+#include "Algoritmi.h"
+#include <cfloat>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define KMEANS_SIMD
+#include <immintrin.h>
+#endif
+
 using namespace std;
 using namespace cv;
 
-Mat kmeans(Mat &input, int k) {
+void kmeans(Mat &input, Mat &out, int k) {
     Mat img = input.clone();
     srand(time(nullptr));
 
@@ -49,23 +56,541 @@ Mat kmeans(Mat &input, int k) {
             break;
     }
 
-    Mat out = img.clone();
+    img.copyTo(out);
     for (int i = 0; i < k; i++)
         for (int j = 0; j < clusters[i].size(); j++)
             out.at<uchar>(clusters[i][j].x, clusters[i][j].y) = centroids[i];
+}
 
+Mat kmeans(Mat &input, int k) {
+    Mat out;
+    kmeans(input, out, k);
     return out;
 }
 
-int main() {
-    Mat src = imread("../immagini/splash.png", IMREAD_GRAYSCALE);
+void kmeansHist(Mat &input, Mat &out, int k, Workspace *ws) {
+    Workspace local;
+    Workspace &w = ws ? *ws : local;
+    srand(time(nullptr));
+
+    vector<uchar> &centroids = w.vec<uchar>("kmeansHist.centroids", k);
+    for (int i = 0; i < k; i++) {
+        int x = rand() % input.rows;
+        int y = rand() % input.cols;
+        centroids[i] = input.at<uchar>(x, y);
+    }
+
+    int hist[256] = {0};
+    for (int x = 0; x < input.rows; x++) {
+        const uchar *row = input.ptr<uchar>(x);
+        for (int y = 0; y < input.cols; y++)
+            hist[row[y]]++;
+    }
+
+    int labels[256] = {0};
+    vector<long long> &sum = w.vec<long long>("kmeansHist.sum", k);
+    vector<long long> &count = w.vec<long long>("kmeansHist.count", k);
+
+    for (int iter = 0; iter < 50; iter++) {
+        fill(sum.begin(), sum.end(), 0);
+        fill(count.begin(), count.end(), 0);
+
+        for (int v = 0; v < 256; v++) {
+            if (hist[v] == 0)
+                continue;
+
+            int best = 0;
+            for (int i = 1; i < k; i++)
+                if (abs(centroids[i] - v) < abs(centroids[best] - v))
+                    best = i;
+            labels[v] = best;
+            sum[best] += (long long) v * hist[v];
+            count[best] += hist[v];
+        }
+
+        bool changed = false;
+        for (int i = 0; i < k; i++) {
+            if (count[i] == 0)
+                continue;
+
+            uchar newCentroid = sum[i] / count[i];
+            if (newCentroid != centroids[i])
+                changed = true;
+            centroids[i] = newCentroid;
+        }
+
+        if (!changed)
+            break;
+    }
+
+    uchar lut[256];
+    for (int v = 0; v < 256; v++)
+        lut[v] = centroids[labels[v]];
+
+    out.create(input.size(), CV_8U);
+    for (int x = 0; x < input.rows; x++) {
+        const uchar *row = input.ptr<uchar>(x);
+        uchar *o = out.ptr<uchar>(x);
+        for (int y = 0; y < input.cols; y++)
+            o[y] = lut[row[y]];
+    }
+}
+
+Mat kmeansHist(Mat &input, int k) {
+    Mat out;
+    kmeansHist(input, out, k);
+    return out;
+}
+
+bool kmeansSimd = true;
+
+static const int KMEANS_MAX_DIMS = 5;
+static const int KMEANS_BAND_ROWS = 64;
+
+static int nearestScalar(const float *feat, size_t N, int D, const float *centers, int k, int *labels, int n,
+                         int end) {
+    for (; n < end; n++) {
+        float best = FLT_MAX;
+        int bestIdx = 0;
+        for (int i = 0; i < k; i++) {
+            float d = 0;
+            for (int dd = 0; dd < D; dd++) {
+                float t = feat[dd * N + n] - centers[i * D + dd];
+                d += t * t;
+            }
+            if (d < best) {
+                best = d;
+                bestIdx = i;
+            }
+        }
+        labels[n] = bestIdx;
+    }
+    return n;
+}
+
+#ifdef KMEANS_SIMD
+__attribute__((target("avx2")))
+static int nearestAVX2(const float *feat, size_t N, int D, const float *centers, int k, int *labels, int n, int end) {
+    for (; n + 8 <= end; n += 8) {
+        __m256 f[KMEANS_MAX_DIMS];
+        for (int dd = 0; dd < D; dd++)
+            f[dd] = _mm256_loadu_ps(feat + dd * N + n);
+
+        __m256 best = _mm256_set1_ps(FLT_MAX);
+        __m256i bestIdx = _mm256_setzero_si256();
+        for (int i = 0; i < k; i++) {
+            __m256 d = _mm256_setzero_ps();
+            for (int dd = 0; dd < D; dd++) {
+                __m256 t = _mm256_sub_ps(f[dd], _mm256_set1_ps(centers[i * D + dd]));
+                d = _mm256_add_ps(d, _mm256_mul_ps(t, t));
+            }
+            __m256 closer = _mm256_cmp_ps(d, best, _CMP_LT_OQ);
+            best = _mm256_blendv_ps(best, d, closer);
+            bestIdx = _mm256_blendv_epi8(bestIdx, _mm256_set1_epi32(i), _mm256_castps_si256(closer));
+        }
+        _mm256_storeu_si256((__m256i *) (labels + n), bestIdx);
+    }
+    return n;
+}
+
+__attribute__((target("sse4.1")))
+static int nearestSSE41(const float *feat, size_t N, int D, const float *centers, int k, int *labels, int n,
+                        int end) {
+    for (; n + 4 <= end; n += 4) {
+        __m128 f[KMEANS_MAX_DIMS];
+        for (int dd = 0; dd < D; dd++)
+            f[dd] = _mm_loadu_ps(feat + dd * N + n);
+
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i bestIdx = _mm_setzero_si128();
+        for (int i = 0; i < k; i++) {
+            __m128 d = _mm_setzero_ps();
+            for (int dd = 0; dd < D; dd++) {
+                __m128 t = _mm_sub_ps(f[dd], _mm_set1_ps(centers[i * D + dd]));
+                d = _mm_add_ps(d, _mm_mul_ps(t, t));
+            }
+            __m128 closer = _mm_cmplt_ps(d, best);
+            best = _mm_blendv_ps(best, d, closer);
+            bestIdx = _mm_blendv_epi8(bestIdx, _mm_set1_epi32(i), _mm_castps_si128(closer));
+        }
+        _mm_storeu_si128((__m128i *) (labels + n), bestIdx);
+    }
+    return n;
+}
+#endif
+
+static void nearest(const float *feat, size_t N, int D, const float *centers, int k, int *labels, int n, int end) {
+#ifdef KMEANS_SIMD
+    static const int level = checkHardwareSupport(CV_CPU_AVX2) ? 2 : checkHardwareSupport(CV_CPU_SSE4_1) ? 1 : 0;
+    if (kmeansSimd && level == 2)
+        n = nearestAVX2(feat, N, D, centers, k, labels, n, end);
+    else if (kmeansSimd && level == 1)
+        n = nearestSSE41(feat, N, D, centers, k, labels, n, end);
+#endif
+    nearestScalar(feat, N, D, centers, k, labels, n, end);
+}
+
+static const float HAMERLY_MARGIN = 1 - 1e-4f;
+
+static float distance2(const float *feat, size_t N, int D, const float *center, int n) {
+    float d = 0;
+    for (int dd = 0; dd < D; dd++) {
+        float t = feat[dd * N + n] - center[dd];
+        d += t * t;
+    }
+    return d;
+}
+
+static void distancesScalar(const float *point, int D, const float *centersT, int stride, int k, float *dist, int i) {
+    for (; i < k; i++) {
+        float d = 0;
+        for (int dd = 0; dd < D; dd++) {
+            float t = point[dd] - centersT[dd * stride + i];
+            d += t * t;
+        }
+        dist[i] = d;
+    }
+}
+
+#ifdef KMEANS_SIMD
+__attribute__((target("avx2")))
+static int distancesAVX2(const float *point, int D, const float *centersT, int stride, int k, float *dist) {
+    int i = 0;
+    for (; i + 8 <= k; i += 8) {
+        __m256 d = _mm256_setzero_ps();
+        for (int dd = 0; dd < D; dd++) {
+            __m256 t = _mm256_sub_ps(_mm256_set1_ps(point[dd]), _mm256_loadu_ps(centersT + dd * stride + i));
+            d = _mm256_add_ps(d, _mm256_mul_ps(t, t));
+        }
+        _mm256_storeu_ps(dist + i, d);
+    }
+    return i;
+}
+
+__attribute__((target("sse4.1")))
+static int distancesSSE41(const float *point, int D, const float *centersT, int stride, int k, float *dist) {
+    int i = 0;
+    for (; i + 4 <= k; i += 4) {
+        __m128 d = _mm_setzero_ps();
+        for (int dd = 0; dd < D; dd++) {
+            __m128 t = _mm_sub_ps(_mm_set1_ps(point[dd]), _mm_loadu_ps(centersT + dd * stride + i));
+            d = _mm_add_ps(d, _mm_mul_ps(t, t));
+        }
+        _mm_storeu_ps(dist + i, d);
+    }
+    return i;
+}
+#endif
+
+static void distances(const float *point, int D, const float *centersT, int stride, int k, float *dist) {
+    int i = 0;
+#ifdef KMEANS_SIMD
+    static const int level = checkHardwareSupport(CV_CPU_AVX2) ? 2 : checkHardwareSupport(CV_CPU_SSE4_1) ? 1 : 0;
+    if (kmeansSimd && level == 2)
+        i = distancesAVX2(point, D, centersT, stride, k, dist);
+    else if (kmeansSimd && level == 1)
+        i = distancesSSE41(point, D, centersT, stride, k, dist);
+#endif
+    distancesScalar(point, D, centersT, stride, k, dist, i);
+}
+
+static size_t nearestBounded(const float *feat, size_t N, int D, const float *centers, const float *centersT,
+                             int stride, int k, const float *half, const float *move, int farthest, float maxMove,
+                             float secondMove, int *labels, float *upper, float *lower, float *dist, int n0,
+                             int n1) {
+    size_t skipped = 0;
+    for (int n = n0; n < n1; n++) {
+        int a = labels[n];
+        if (a >= 0) {
+            upper[n] += move[a];
+            lower[n] -= a == farthest ? secondMove : maxMove;
+
+            float bound = max(half[a], lower[n]) * HAMERLY_MARGIN;
+            if (upper[n] < bound) {
+                skipped += k;
+                continue;
+            }
+            upper[n] = sqrt(distance2(feat, N, D, &centers[a * D], n));
+            if (upper[n] < bound) {
+                skipped += k - 1;
+                continue;
+            }
+        }
+
+        float point[KMEANS_MAX_DIMS];
+        for (int dd = 0; dd < D; dd++)
+            point[dd] = feat[dd * N + n];
+        distances(point, D, centersT, stride, k, dist);
+
+        float best = FLT_MAX, second = FLT_MAX;
+        int bestIdx = 0;
+        for (int i = 0; i < k; i++) {
+            float d = dist[i];
+            if (d < best) {
+                second = best;
+                best = d;
+                bestIdx = i;
+            } else if (d < second)
+                second = d;
+        }
+        labels[n] = bestIdx;
+        upper[n] = sqrt(best);
+        lower[n] = sqrt(second);
+    }
+    return skipped;
+}
+
+static void accumulate(const float *feat, size_t N, int C, int D, int cols, int n, long long *sum, int sign) {
+    for (int c = 0; c < C; c++)
+        sum[c] += sign * (long long) feat[c * N + n];
+    if (D > C) {
+        sum[C] += sign * (n % cols);
+        sum[C + 1] += sign * (n / cols);
+    }
+}
+
+static int channelsOf(const Mat &input) {
+    return input.channels() == 3 ? 3 : 1;
+}
+
+static void buildFeatures(const Mat &input, bool lab, float scale, vector<float> &feat, int D, Workspace &ws) {
+    int rows = input.rows, cols = input.cols, C = channelsOf(input);
+    size_t N = (size_t) rows * cols;
 
-    int k = 3;
+    const Mat *src = &input;
+    if (lab && C == 3) {
+        Mat &converted = ws.mat("kmeansColor.lab", rows, cols, CV_8UC3);
+        cvtColor(input, converted, COLOR_BGR2Lab);
+        src = &converted;
+    }
 
-    Mat dst = kmeans(src, k);
+    auto fill = [&](const Range &range) {
+        for (int x = range.start; x < range.end; x++) {
+            const uchar *row = src->ptr<uchar>(x);
+            size_t base = (size_t) x * cols;
+            for (int y = 0; y < cols; y++) {
+                for (int c = 0; c < C; c++)
+                    feat[c * N + base + y] = row[y * C + c];
+                if (D > C) {
+                    feat[C * N + base + y] = y * scale;
+                    feat[(C + 1) * N + base + y] = x * scale;
+                }
+            }
+        }
+    };
+    parallel_for_(Range(0, rows), cref(fill));
+}
+
+void kmeansColor(Mat &input, Mat &out, int k, bool lab, float spatialWeight, int batchSize, bool hamerly,
+                 size_t *skipped, Workspace *ws) {
+    CV_Assert(input.type() == CV_8UC3 || input.type() == CV_8U);
+    Workspace local;
+    Workspace &w = ws ? *ws : local;
+
+    int rows = input.rows, cols = input.cols, C = channelsOf(input);
+    int D = C + (spatialWeight > 0 ? 2 : 0);
+    size_t N = (size_t) rows * cols;
+    if (skipped)
+        *skipped = 0;
+    if (N == 0) {
+        out.release();
+        return;
+    }
+    k = max(1, min(k, (int) N));
 
-    imshow("K-means", dst);
-    waitKey(0);
+    float scale = spatialWeight * 255.f / max(rows, cols);
+    vector<float> &feat = w.vec<float>("kmeansColor.features", D * N);
+    buildFeatures(input, lab, scale, feat, D, w);
 
-    return 0;
+    RNG rng;
+    vector<float> &centers = w.vec<float>("kmeansColor.centers", k * D);
+    for (int i = 0; i < k; i++) {
+        int n = rng.uniform(0, (int) N);
+        for (int dd = 0; dd < D; dd++)
+            centers[i * D + dd] = feat[dd * N + n];
+    }
+
+    vector<int> &labels = w.vec<int>("kmeansColor.labels", N);
+    int nBands = (rows + KMEANS_BAND_ROWS - 1) / KMEANS_BAND_ROWS;
+    vector<long long> &sums = w.vec<long long>("kmeansColor.sums", nBands * k * D);
+    vector<int> &counts = w.vec<int>("kmeansColor.counts", nBands * k);
+    fill(sums.begin(), sums.end(), 0);
+    fill(counts.begin(), counts.end(), 0);
+    vector<int> &changes = w.vec<int>("kmeansColor.changes", nBands);
+    w.reserve(nBands);
+
+    bool bounded = hamerly && batchSize <= 0;
+    vector<float> &upper = w.vec<float>("kmeansColor.upper", bounded ? N : 0);
+    vector<float> &lower = w.vec<float>("kmeansColor.lower", bounded ? N : 0);
+    vector<float> &half = w.vec<float>("kmeansColor.half", k);
+    vector<float> &move = w.vec<float>("kmeansColor.move", k);
+    vector<float> &oldCenters = w.vec<float>("kmeansColor.oldCenters", k * D);
+    int stride = (k + 7) / 8 * 8;
+    vector<float> &centersT = w.vec<float>("kmeansColor.centersT", bounded ? D * stride : 0);
+    vector<size_t> &bandSkipped = w.vec<size_t>("kmeansColor.skipped", nBands);
+    fill(move.begin(), move.end(), 0.f);
+    fill(bandSkipped.begin(), bandSkipped.end(), 0);
+    int farthest = 0;
+    float maxMove = 0, secondMove = 0;
+
+    auto assign = [&](const Range &range) {
+        for (int b = range.start; b < range.end; b++) {
+            int n0 = b * KMEANS_BAND_ROWS * cols, n1 = min(rows, (b + 1) * KMEANS_BAND_ROWS) * cols;
+            vector<int> &prev = w.vec<int>("kmeansColor.previous", n1 - n0, b);
+            copy(labels.begin() + n0, labels.begin() + n1, prev.begin());
+            if (bounded) {
+                vector<float> &dist = w.vec<float>("kmeansColor.dist", k, b);
+                bandSkipped[b] += nearestBounded(&feat[0], N, D, &centers[0], &centersT[0], stride, k, &half[0],
+                                                 &move[0], farthest, maxMove, secondMove, &labels[0], &upper[0],
+                                                 &lower[0], &dist[0], n0, n1);
+            } else
+                nearest(&feat[0], N, D, &centers[0], k, &labels[0], n0, n1);
+
+            long long *s = &sums[b * k * D];
+            int *cnt = &counts[b * k];
+            if (!bounded) {
+                fill(s, s + k * D, 0);
+                fill(cnt, cnt + k, 0);
+            }
+            changes[b] = 0;
+            for (int n = n0; n < n1; n++) {
+                int l = labels[n], p = prev[n - n0];
+                if (bounded && l == p)
+                    continue;
+                if (bounded && p >= 0) {
+                    accumulate(&feat[0], N, C, D, cols, n, &s[p * D], -1);
+                    cnt[p]--;
+                }
+                accumulate(&feat[0], N, C, D, cols, n, &s[l * D], 1);
+                cnt[l]++;
+                changes[b] += l != p;
+            }
+        }
+    };
+
+    if (batchSize > 0) {
+        vector<int> &seen = w.vec<int>("kmeansColor.seen", k);
+        vector<int> &batch = w.vec<int>("kmeansColor.batch", batchSize);
+        vector<int> &batchLabels = w.vec<int>("kmeansColor.batchLabels", batchSize);
+        fill(seen.begin(), seen.end(), 0);
+
+        for (int iter = 0; iter < 50; iter++) {
+            for (int j = 0; j < batchSize; j++)
+                batch[j] = rng.uniform(0, (int) N);
+
+            for (int j = 0; j < batchSize; j++) {
+                float best = FLT_MAX;
+                for (int i = 0; i < k; i++) {
+                    float d = 0;
+                    for (int dd = 0; dd < D; dd++) {
+                        float t = feat[dd * N + batch[j]] - centers[i * D + dd];
+                        d += t * t;
+                    }
+                    if (d < best) {
+                        best = d;
+                        batchLabels[j] = i;
+                    }
+                }
+            }
+
+            for (int j = 0; j < batchSize; j++) {
+                int i = batchLabels[j];
+                float eta = 1.f / ++seen[i];
+                for (int dd = 0; dd < D; dd++)
+                    centers[i * D + dd] += eta * (feat[dd * N + batch[j]] - centers[i * D + dd]);
+            }
+        }
+        fill(labels.begin(), labels.end(), -1);
+        parallel_for_(Range(0, nBands), cref(assign));
+    } else {
+        fill(labels.begin(), labels.end(), -1);
+        for (int iter = 0; iter < 50; iter++) {
+            for (int i = 0; bounded && i < k; i++)
+                for (int dd = 0; dd < D; dd++)
+                    centersT[dd * stride + i] = centers[i * D + dd];
+            parallel_for_(Range(0, nBands), cref(assign));
+
+            int changed = 0;
+            for (int b = 0; b < nBands; b++)
+                changed += changes[b];
+            copy(centers.begin(), centers.end(), oldCenters.begin());
+
+            for (int i = 0; i < k; i++) {
+                long long s[KMEANS_MAX_DIMS] = {0};
+                long long cnt = 0;
+                for (int b = 0; b < nBands; b++) {
+                    for (int dd = 0; dd < D; dd++)
+                        s[dd] += sums[(b * k + i) * D + dd];
+                    cnt += counts[b * k + i];
+                }
+                if (cnt == 0)
+                    continue;
+                for (int dd = 0; dd < D; dd++)
+                    centers[i * D + dd] = (float) ((double) s[dd] / cnt * (dd < C ? 1 : scale));
+            }
+
+            if (!changed)
+                break;
+
+            if (bounded) {
+                maxMove = secondMove = 0;
+                for (int i = 0; i < k; i++) {
+                    float d2 = 0;
+                    for (int dd = 0; dd < D; dd++) {
+                        float t = centers[i * D + dd] - oldCenters[i * D + dd];
+                        d2 += t * t;
+                    }
+                    move[i] = sqrt(d2) / HAMERLY_MARGIN;
+                    if (move[i] > maxMove) {
+                        secondMove = maxMove;
+                        maxMove = move[i];
+                        farthest = i;
+                    } else if (move[i] > secondMove)
+                        secondMove = move[i];
+                }
+
+                for (int i = 0; i < k; i++) {
+                    float nearestCenter = FLT_MAX;
+                    for (int j = 0; j < k; j++)
+                        if (j != i)
+                            nearestCenter = min(nearestCenter, distance2(&centers[j * D], 1, D, &centers[i * D], 0));
+                    half[i] = sqrt(nearestCenter) / 2;
+                }
+            }
+        }
+    }
+
+    if (skipped) {
+        *skipped = 0;
+        for (int b = 0; b < nBands; b++)
+            *skipped += bandSkipped[b];
+    }
+
+    Mat *palette = &w.mat("kmeansColor.palette", k, 1, CV_MAKETYPE(CV_8U, C));
+    for (int i = 0; i < k; i++)
+        for (int c = 0; c < C; c++)
+            palette->ptr<uchar>(i)[c] = saturate_cast<uchar>(centers[i * D + c]);
+    if (lab && C == 3) {
+        Mat &bgr = w.mat("kmeansColor.paletteBGR", k, 1, CV_8UC3);
+        cvtColor(*palette, bgr, COLOR_Lab2BGR);
+        palette = &bgr;
+    }
+
+    out.create(input.size(), input.type());
+    auto paint = [&](const Range &range) {
+        for (int x = range.start; x < range.end; x++) {
+            const int *l = &labels[(size_t) x * cols];
+            uchar *o = out.ptr<uchar>(x);
+            for (int y = 0; y < cols; y++)
+                for (int c = 0; c < C; c++)
+                    o[y * C + c] = palette->ptr<uchar>(l[y])[c];
+        }
+    };
+    parallel_for_(Range(0, rows), cref(paint));
+}
+
+Mat kmeansColor(Mat &input, int k, bool lab, float spatialWeight, int batchSize, bool hamerly) {
+    Mat out;
+    kmeansColor(input, out, k, lab, spatialWeight, batchSize, hamerly);
+    return out;
 }